@@ -0,0 +1,470 @@
+// Load generator: replays a mix of finds, inserts and erases from several
+// threads against one shared tree, and reports throughput, latency percentiles
+// and metric calls. Everything runs on generated data; see usage() for the
+// options.
+
+#include "../bktree/bktree.hpp"
+#include "../bktree/concurrent.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <latch>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <shared_mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// EditDistance counting its calls on each thread, prepared queries included
+struct CountingEdit : bk_tree::metrics::Distance<CountingEdit> {
+  using sketch_type = bk_tree::metrics::WordSketch;
+  static inline thread_local size_t evaluations = 0;
+  bk_tree::metrics::EditDistance metric;
+
+  class Prepared {
+  public:
+    Prepared(const bk_tree::metrics::EditDistance &metric, std::string_view query)
+        : m_prepared(metric.prepare(query)) {}
+    std::string_view query() const noexcept { return m_prepared.query(); }
+    bk_tree::integer_type operator()(std::string_view t) const {
+      ++evaluations;
+      return m_prepared(t);
+    }
+    void batch(std::span<const std::string_view> words,
+               std::span<bk_tree::integer_type> output) const {
+      evaluations += words.size();
+      m_prepared.batch(words, output);
+    }
+
+  private:
+    bk_tree::metrics::EditDistance::Prepared m_prepared;
+  };
+  Prepared prepare(std::string_view query) const { return Prepared(metric, query); }
+
+  bk_tree::integer_type compute_distance(std::string_view s, std::string_view t) const {
+    ++evaluations;
+    return metric(s, t);
+  }
+  bk_tree::integer_type lower_bound(const sketch_type &s, const sketch_type &t) const {
+    return metric.lower_bound(s, t);
+  }
+  bk_tree::integer_type upper_bound(const sketch_type &s, const sketch_type &t) const {
+    return metric.upper_bound(s, t);
+  }
+};
+
+/**
+ * @brief Log-linear latency histogram in nanoseconds
+ *
+ * Values below 16 have a bucket each; above, every power of two is split into
+ * 16 buckets, so a reported percentile is within 1/16 of the true value.
+ */
+class Histogram {
+public:
+  void record(std::uint64_t value) noexcept {
+    ++m_counts[bucket(value)];
+    ++m_total;
+    m_max = std::max(m_max, value);
+  }
+
+  void merge(const Histogram &other) noexcept {
+    for (size_t i = 0; i < m_counts.size(); ++i) {
+      m_counts[i] += other.m_counts[i];
+    }
+    m_total += other.m_total;
+    m_max = std::max(m_max, other.m_max);
+  }
+
+  std::uint64_t total() const noexcept { return m_total; }
+  std::uint64_t max() const noexcept { return m_max; }
+
+  // Upper end of the bucket holding the q-quantile
+  std::uint64_t percentile(double q) const noexcept {
+    const auto rank = static_cast<std::uint64_t>(q * static_cast<double>(m_total));
+    std::uint64_t seen = 0;
+    for (size_t i = 0; i < m_counts.size(); ++i) {
+      seen += m_counts[i];
+      if (seen > rank) {
+        return std::min(upper(i), m_max);
+      }
+    }
+    return m_max;
+  }
+
+private:
+  static constexpr unsigned sub_buckets = 16;
+
+  static size_t bucket(std::uint64_t value) noexcept {
+    if (value < sub_buckets) {
+      return value;
+    }
+    const unsigned shift = std::bit_width(value) - 5;
+    return (shift + 1) * sub_buckets + ((value >> shift) & (sub_buckets - 1));
+  }
+
+  static std::uint64_t upper(size_t index) noexcept {
+    if (index < sub_buckets) {
+      return index;
+    }
+    const size_t shift = index / sub_buckets - 1;
+    const std::uint64_t base = (index % sub_buckets + sub_buckets) << shift;
+    return base + (std::uint64_t{1} << shift) - 1;
+  }
+
+  std::array<std::uint64_t, sub_buckets * 64> m_counts{};
+  std::uint64_t m_total = 0;
+  std::uint64_t m_max = 0;
+};
+
+/**
+ * @brief Draws ranks 0 to n - 1 with probability proportional to 1 / (rank +
+ * 1)^s; s = 0 is uniform
+ */
+class Zipf {
+public:
+  Zipf(size_t n, double s) : m_cdf(n) {
+    double sum = 0;
+    for (size_t i = 0; i < n; ++i) {
+      sum += 1.0 / std::pow(static_cast<double>(i + 1), s);
+      m_cdf[i] = sum;
+    }
+    for (auto &c : m_cdf) {
+      c /= sum;
+    }
+  }
+
+  template <typename Rng>
+  size_t operator()(Rng &rng) const {
+    const double u = std::uniform_real_distribution<double>(0, 1)(rng);
+    auto it = std::lower_bound(m_cdf.begin(), m_cdf.end(), u);
+    return std::min<size_t>(it - m_cdf.begin(), m_cdf.size() - 1);
+  }
+
+private:
+  std::vector<double> m_cdf;
+};
+
+struct Options {
+  size_t threads = 4;
+  size_t words = 100000;
+  double seconds = 3;
+  double write_ratio = 0.05;
+  double zipf = 1.0;
+  double typo_rate = 0.5;
+  // Weights of the find radii 0, 1, 2, ...
+  std::vector<double> radii{0, 6, 3, 1};
+  std::string tree = "concurrent";
+  unsigned seed = 42;
+};
+
+void usage(const char *program) {
+  std::fprintf(stderr,
+               "usage: %s [--option=value ...]\n"
+               "  --threads=N        worker threads (4)\n"
+               "  --words=N          dictionary size (100000)\n"
+               "  --seconds=S        run time (3)\n"
+               "  --write-ratio=R    share of operations that write, split\n"
+               "                     evenly between insert and erase (0.05)\n"
+               "  --zipf=S           key skew exponent, 0 for uniform (1.0)\n"
+               "  --typo-rate=R      share of finds for a misspelled key (0.5)\n"
+               "  --radii=W0,W1,...  weights of find radius 0, 1, ... (0,6,3,1)\n"
+               "  --tree=KIND        concurrent (ConcurrentBKTree) or locked\n"
+               "                     (BKTree behind a shared_mutex)\n"
+               "  --seed=N           random seed (42)\n",
+               program);
+}
+
+template <typename T>
+bool parse_number(std::string_view text, T &value) {
+  if constexpr (std::is_floating_point_v<T>) {
+    char *end = nullptr;
+    const std::string copy(text);
+    value = static_cast<T>(std::strtod(copy.c_str(), &end));
+    return end != copy.c_str() && *end == '\0';
+  } else {
+    auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return error == std::errc() && end == text.data() + text.size();
+  }
+}
+
+bool parse(int argc, char **argv, Options &options) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view arg = argv[i];
+    const size_t equals = arg.find('=');
+    if (!arg.starts_with("--") || equals == std::string_view::npos) {
+      return false;
+    }
+    const std::string_view name = arg.substr(2, equals - 2);
+    const std::string_view value = arg.substr(equals + 1);
+    bool ok = true;
+    if (name == "threads") {
+      ok = parse_number(value, options.threads) && options.threads > 0;
+    } else if (name == "words") {
+      ok = parse_number(value, options.words) && options.words > 0;
+    } else if (name == "seconds") {
+      ok = parse_number(value, options.seconds) && options.seconds > 0;
+    } else if (name == "write-ratio") {
+      ok = parse_number(value, options.write_ratio) && options.write_ratio >= 0 &&
+           options.write_ratio <= 1;
+    } else if (name == "zipf") {
+      ok = parse_number(value, options.zipf) && options.zipf >= 0;
+    } else if (name == "typo-rate") {
+      ok = parse_number(value, options.typo_rate) && options.typo_rate >= 0 &&
+           options.typo_rate <= 1;
+    } else if (name == "radii") {
+      options.radii.clear();
+      for (std::string_view rest = value; ok && !rest.empty();) {
+        const size_t comma = std::min(rest.find(','), rest.size());
+        double weight = 0;
+        ok = parse_number(rest.substr(0, comma), weight) && weight >= 0;
+        options.radii.push_back(weight);
+        rest.remove_prefix(std::min(comma + 1, rest.size()));
+      }
+      ok = ok && std::any_of(options.radii.begin(), options.radii.end(),
+                             [](double w) { return w > 0; });
+    } else if (name == "tree") {
+      options.tree = value;
+      ok = value == "concurrent" || value == "locked";
+    } else if (name == "seed") {
+      ok = parse_number(value, options.seed);
+    } else {
+      ok = false;
+    }
+    if (!ok) {
+      std::fprintf(stderr, "invalid option: %s\n", argv[i]);
+      return false;
+    }
+  }
+  return true;
+}
+
+std::string random_word(std::mt19937 &rng) {
+  std::uniform_int_distribution<int> length(4, 12), letter('a', 'z');
+  std::string word(length(rng), ' ');
+  for (auto &c : word) {
+    c = static_cast<char>(letter(rng));
+  }
+  return word;
+}
+
+void misspell(std::string &word, std::mt19937 &rng) {
+  const size_t at = rng() % (word.size() + 1);
+  const char c = static_cast<char>('a' + rng() % 26);
+  switch (rng() % 3) {
+  case 0:
+    word.insert(word.begin() + at, c);
+    break;
+  case 1:
+    if (at < word.size()) {
+      word.erase(at, 1);
+    }
+    break;
+  default:
+    if (at < word.size()) {
+      word[at] = c;
+    }
+  }
+}
+
+// BKTree made shareable with a readers-writer lock, for comparison
+class LockedTree {
+public:
+  bool insert(std::string_view value) {
+    std::unique_lock lock(m_mutex);
+    return m_tree.insert(value);
+  }
+  bool erase(std::string_view value) {
+    std::unique_lock lock(m_mutex);
+    return m_tree.erase(value);
+  }
+  bk_tree::ResultList find(std::string_view value, int limit) const {
+    std::shared_lock lock(m_mutex);
+    return m_tree.find(value, limit);
+  }
+  size_t size() const {
+    std::shared_lock lock(m_mutex);
+    return m_tree.size();
+  }
+
+private:
+  mutable std::shared_mutex m_mutex;
+  bk_tree::BKTree<CountingEdit> m_tree;
+};
+
+enum Operation { find_op, insert_op, erase_op, operation_count };
+constexpr const char *operation_names[] = {"find", "insert", "erase"};
+
+struct WorkerStats {
+  std::array<Histogram, operation_count> latency;
+  size_t evaluations = 0;
+  size_t find_evaluations = 0;
+  size_t matches = 0;
+};
+
+template <typename Tree>
+int run(const Options &options) {
+  std::mt19937 rng(options.seed);
+  std::vector<std::string> dictionary(options.words);
+  for (auto &w : dictionary) {
+    w = random_word(rng);
+  }
+  // Hot keys are spread over the dictionary rather than its first entries
+  std::vector<size_t> ranks(dictionary.size());
+  std::iota(ranks.begin(), ranks.end(), 0);
+  std::shuffle(ranks.begin(), ranks.end(), rng);
+
+  Tree tree;
+  const auto load_start = std::chrono::steady_clock::now();
+  for (auto const &w : dictionary) {
+    tree.insert(w);
+  }
+  const double load_seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - load_start)
+          .count();
+
+  const Zipf keys(dictionary.size(), options.zipf);
+  const std::discrete_distribution<int> radius(options.radii.begin(),
+                                               options.radii.end());
+  std::vector<WorkerStats> stats(options.threads);
+  std::atomic<bool> stop = false;
+  std::latch ready(static_cast<std::ptrdiff_t>(options.threads) + 1);
+
+  auto work = [&](size_t worker) {
+    std::mt19937 local(options.seed + 1 + static_cast<unsigned>(worker));
+    std::uniform_real_distribution<double> coin(0, 1);
+    auto draw_radius = radius;
+    auto &own = stats[worker];
+    // Words this thread inserted and may erase again, oldest first
+    std::deque<std::string> inserted;
+    ready.arrive_and_wait();
+    while (!stop.load(std::memory_order_relaxed)) {
+      Operation op = find_op;
+      std::string key;
+      if (coin(local) < options.write_ratio) {
+        op = inserted.empty() || coin(local) < 0.5 ? insert_op : erase_op;
+      }
+      if (op == insert_op) {
+        key = dictionary[ranks[keys(local)]];
+        misspell(key, local);
+      } else if (op == erase_op) {
+        key = std::move(inserted.front());
+        inserted.pop_front();
+      } else {
+        key = dictionary[ranks[keys(local)]];
+        if (coin(local) < options.typo_rate) {
+          misspell(key, local);
+        }
+      }
+      const int limit = draw_radius(local);
+
+      const size_t before = CountingEdit::evaluations;
+      const auto start = std::chrono::steady_clock::now();
+      switch (op) {
+      case find_op:
+        own.matches += tree.find(key, limit).size();
+        break;
+      case insert_op:
+        if (tree.insert(key)) {
+          inserted.push_back(std::move(key));
+        }
+        break;
+      default:
+        tree.erase(key);
+      }
+      const auto elapsed = std::chrono::steady_clock::now() - start;
+      own.latency[op].record(static_cast<std::uint64_t>(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+      if (op == find_op) {
+        own.find_evaluations += CountingEdit::evaluations - before;
+      }
+    }
+    own.evaluations = CountingEdit::evaluations;
+  };
+
+  std::vector<std::thread> workers;
+  for (size_t worker = 0; worker < options.threads; ++worker) {
+    workers.emplace_back(work, worker);
+  }
+  ready.arrive_and_wait();
+  const auto start = std::chrono::steady_clock::now();
+  std::this_thread::sleep_for(std::chrono::duration<double>(options.seconds));
+  stop.store(true);
+  for (auto &w : workers) {
+    w.join();
+  }
+  const double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  WorkerStats total;
+  for (auto const &s : stats) {
+    for (size_t op = 0; op < operation_count; ++op) {
+      total.latency[op].merge(s.latency[op]);
+    }
+    total.evaluations += s.evaluations;
+    total.find_evaluations += s.find_evaluations;
+    total.matches += s.matches;
+  }
+  size_t operations = 0;
+  for (auto const &h : total.latency) {
+    operations += h.total();
+  }
+
+  std::printf("tree=%s threads=%zu words=%zu seconds=%.1f write-ratio=%.3f "
+              "zipf=%.2f typo-rate=%.2f radii=",
+              options.tree.c_str(), options.threads, options.words, seconds,
+              options.write_ratio, options.zipf, options.typo_rate);
+  for (size_t i = 0; i < options.radii.size(); ++i) {
+    std::printf("%s%g", i == 0 ? "" : ",", options.radii[i]);
+  }
+  std::printf("\nloaded %zu words in %.2f s; %zu words at the end\n\n", options.words,
+              load_seconds, tree.size());
+  std::printf("%-8s %12s %10s %10s %10s %10s %10s\n", "op", "count", "ops/s",
+              "p50 us", "p99 us", "p999 us", "max us");
+  for (size_t op = 0; op < operation_count; ++op) {
+    const Histogram &h = total.latency[op];
+    if (h.total() == 0) {
+      continue;
+    }
+    auto us = [](std::uint64_t ns) { return static_cast<double>(ns) / 1000; };
+    std::printf("%-8s %12llu %10.0f %10.1f %10.1f %10.1f %10.1f\n",
+                operation_names[op], static_cast<unsigned long long>(h.total()),
+                static_cast<double>(h.total()) / seconds, us(h.percentile(0.5)),
+                us(h.percentile(0.99)), us(h.percentile(0.999)), us(h.max()));
+  }
+  const auto finds = static_cast<double>(std::max<std::uint64_t>(
+      total.latency[find_op].total(), 1));
+  std::printf("\nthroughput: %.0f ops/s\n", static_cast<double>(operations) / seconds);
+  std::printf("metric calls: %zu (%.1f per find, %.2f matches per find)\n",
+              total.evaluations, static_cast<double>(total.find_evaluations) / finds,
+              static_cast<double>(total.matches) / finds);
+  return 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options options;
+  if (!parse(argc, argv, options)) {
+    usage(argv[0]);
+    return 2;
+  }
+  if (options.tree == "locked") {
+    return run<LockedTree>(options);
+  }
+  return run<bk_tree::ConcurrentBKTree<CountingEdit>>(options);
+}
@@ -1,11 +1,90 @@
+#include "../bktree/bkforest.hpp"
 #include "../bktree/bktree.hpp"
+#include "../bktree/cache.hpp"
+#include "../bktree/compact.hpp"
+#include "../bktree/concurrent.hpp"
+#include "../bktree/durable.hpp"
+#include "../bktree/join.hpp"
+#include "../bktree/mmap.hpp"
+#include "../bktree/qgram.hpp"
 
 #include <benchmark/benchmark.h>
 
+#include <filesystem>
+#include <fstream>
+#include <memory_resource>
+#include <random>
+#include <string>
 #include <string_view>
+#include <vector>
 
 constexpr static const std::string_view word = "word";
 
+static std::vector<std::string> generate_words(size_t count, unsigned seed = 42) {
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<int> length(4, 12), letter('a', 'z');
+  std::vector<std::string> words(count);
+  for (auto &w : words) {
+    w.resize(length(rng));
+    for (auto &c : w) {
+      c = static_cast<char>(letter(rng));
+    }
+  }
+  return words;
+}
+
+// Pronounceable words built from syllables, so that neighbourhoods are as
+// uneven as in a natural-language dictionary
+static std::vector<std::string> generate_dictionary(size_t count, unsigned seed = 42) {
+  static constexpr std::string_view onsets[] = {"", "b", "br", "c", "ch", "d", "f",
+                                                "g", "gr", "h", "k", "l", "m", "n",
+                                                "p", "pl", "r", "s", "st", "t", "tr",
+                                                "v", "w"};
+  static constexpr std::string_view nuclei[] = {"a", "e", "i", "o", "u", "ea", "ou"};
+  static constexpr std::string_view codas[] = {"", "", "n", "r", "s", "t", "ng", "ck"};
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<int> syllables(1, 4);
+  auto pick = [&rng](auto const &parts) {
+    return parts[std::uniform_int_distribution<size_t>(0, std::size(parts) - 1)(rng)];
+  };
+  std::vector<std::string> words(count);
+  for (auto &w : words) {
+    for (int i = syllables(rng); i > 0; --i) {
+      w.append(pick(onsets)).append(pick(nuclei)).append(pick(codas));
+    }
+  }
+  return words;
+}
+
+// Copies of dictionary words with one or two random typos
+static std::vector<std::string> misspell(const std::vector<std::string> &words,
+                                         size_t count, unsigned seed = 7) {
+  std::mt19937 rng(seed);
+  std::vector<std::string> queries(count);
+  for (auto &q : queries) {
+    q = words[rng() % words.size()];
+    for (int typos = 1 + rng() % 2; typos > 0; --typos) {
+      const size_t at = rng() % (q.size() + 1);
+      const char c = static_cast<char>('a' + rng() % 26);
+      switch (rng() % 3) {
+      case 0:
+        q.insert(q.begin() + at, c);
+        break;
+      case 1:
+        if (at < q.size()) {
+          q.erase(at, 1);
+        }
+        break;
+      default:
+        if (at < q.size()) {
+          q[at] = c;
+        }
+      }
+    }
+  }
+  return queries;
+}
+
 #define BKTREE_BENCHMARK_CASE(F, N)                                                    \
   void Bench_##F(benchmark::State &state) {                                            \
     bk_tree::BKTree<bk_tree::metrics::N> tree;                                         \
@@ -22,6 +101,735 @@ BKTREE_BENCHMARK_CASE(TreeLCSubseqInsert, LCSubseqDistance)
 BKTREE_BENCHMARK_CASE(TreeEditInsert, EditDistance)
 BKTREE_BENCHMARK_CASE(TreeDamerauLevenshteinInsert, DamerauLevenshteinDistance)
 
+template <typename Metric>
+void Bench_DistancePairs(benchmark::State &state) {
+  const Metric metric;
+  const auto words = generate_words(1024);
+  for (auto _ : state) {
+    for (size_t i = 0; i + 1 < words.size(); i += 2) {
+      benchmark::DoNotOptimize(metric(words[i], words[i + 1]));
+    }
+  }
+}
+BENCHMARK(Bench_DistancePairs<bk_tree::metrics::EditDistance>)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(Bench_DistancePairs<
+              bk_tree::metrics::WeightedEditDistance<bk_tree::metrics::UnitCost>>)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(Bench_DistancePairs<
+              bk_tree::metrics::WeightedEditDistance<bk_tree::metrics::QwertyCost>>)
+    ->Unit(benchmark::kMicrosecond);
+
+template <typename Metric>
+void Bench_LongDistancePairs(benchmark::State &state) {
+  const Metric metric;
+  std::mt19937 rng(3);
+  std::uniform_int_distribution<int> letter('a', 'z');
+  std::vector<std::string> words(16, std::string(state.range(0), ' '));
+  for (auto &w : words) {
+    for (auto &c : w) {
+      c = static_cast<char>(letter(rng));
+    }
+  }
+  for (auto _ : state) {
+    for (size_t i = 0; i + 1 < words.size(); i += 2) {
+      benchmark::DoNotOptimize(metric(words[i], words[i + 1]));
+    }
+  }
+}
+BENCHMARK(Bench_LongDistancePairs<bk_tree::metrics::EditDistance>)
+    ->Arg(64)
+    ->Arg(1000)
+    ->Arg(4000)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(Bench_LongDistancePairs<bk_tree::metrics::DamerauLevenshteinDistance>)
+    ->Arg(64)
+    ->Arg(1000)
+    ->Arg(4000)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(Bench_LongDistancePairs<bk_tree::metrics::LCSubseqDistance>)
+    ->Arg(64)
+    ->Arg(1000)
+    ->Arg(4000)
+    ->Unit(benchmark::kMicrosecond);
+
+void Bench_TreeEditFindLargeRadius(benchmark::State &state) {
+  bk_tree::BKTree<bk_tree::metrics::EditDistance> tree;
+  for (auto const &w : generate_words(50000)) {
+    tree.insert(w);
+  }
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(tree.find("mispelled", static_cast<int>(state.range(0))));
+  }
+}
+BENCHMARK(Bench_TreeEditFindLargeRadius)->Arg(2)->Arg(4)->Unit(benchmark::kMillisecond);
+
+void Bench_ForestEditFindLargeRadius(benchmark::State &state) {
+  bk_tree::BKForest<bk_tree::metrics::EditDistance> forest;
+  for (auto const &w : generate_words(50000)) {
+    forest.insert(w);
+  }
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        forest.find("mispelled", static_cast<int>(state.range(0))));
+  }
+}
+BENCHMARK(Bench_ForestEditFindLargeRadius)
+    ->Arg(2)
+    ->Arg(4)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+void Bench_TreeEditFindMisses(benchmark::State &state) {
+  bk_tree::BKTree<bk_tree::metrics::EditDistance> tree;
+  for (auto const &w : generate_words(20000)) {
+    tree.insert(w);
+  }
+  const auto queries = generate_words(4096, 7);
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(tree.find(queries[i++ % queries.size()], 1));
+  }
+}
+BENCHMARK(Bench_TreeEditFindMisses)->Unit(benchmark::kMicrosecond);
+
+// One query against 4096 words: mode 0 calls the metric, 1 a prepared query,
+// 2 its batch method
+void Bench_EditPreparedQuery(benchmark::State &state) {
+  const auto words = generate_words(4096);
+  const std::vector<std::string_view> views(words.begin(), words.end());
+  std::vector<bk_tree::integer_type> distances(views.size());
+  const auto queries = generate_words(64, 7);
+  const bk_tree::metrics::EditDistance metric;
+  size_t i = 0;
+  for (auto _ : state) {
+    const std::string_view query = queries[i++ % queries.size()];
+    const auto prepared = metric.prepare(query);
+    for (size_t j = 0; state.range(0) < 2 && j < views.size(); ++j) {
+      distances[j] = state.range(0) == 0 ? metric(query, views[j]) : prepared(views[j]);
+    }
+    if (state.range(0) == 2) {
+      prepared.batch(views, distances);
+    }
+    benchmark::DoNotOptimize(distances.data());
+  }
+}
+BENCHMARK(Bench_EditPreparedQuery)
+    ->ArgName("mode")
+    ->Arg(0)
+    ->Arg(1)
+    ->Arg(2)
+    ->Unit(benchmark::kMicrosecond);
+
+// Erasing words absent from a 50000-word tree, with and without the membership
+// index
+void Bench_TreeEditEraseMiss(benchmark::State &state) {
+  bk_tree::BKTree<bk_tree::metrics::EditDistance> tree;
+  tree.set_membership_index(state.range(0) != 0);
+  for (auto const &w : generate_words(50000)) {
+    tree.insert(w);
+  }
+  const auto queries = generate_words(4096, 7);
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(tree.erase(queries[i++ % queries.size()]));
+  }
+}
+BENCHMARK(Bench_TreeEditEraseMiss)
+    ->ArgName("indexed")
+    ->Arg(0)
+    ->Arg(1)
+    ->Unit(benchmark::kNanosecond);
+
+// Re-inserting words already in a 50000-word tree while keeping it a set;
+// mode 0 checks with find, 1 with contains, 2 relies on the membership index
+void Bench_TreeEditDuplicateInsert(benchmark::State &state) {
+  bk_tree::BKTree<bk_tree::metrics::EditDistance> tree;
+  tree.set_membership_index(state.range(0) == 2);
+  const auto words = generate_words(50000);
+  for (auto const &w : words) {
+    tree.insert(w);
+  }
+  size_t i = 0;
+  for (auto _ : state) {
+    auto const &w = words[i++ % words.size()];
+    switch (state.range(0)) {
+    case 0:
+      benchmark::DoNotOptimize(tree.find(w, 0).empty() && tree.insert(w));
+      break;
+    case 1:
+      benchmark::DoNotOptimize(!tree.contains(w) && tree.insert(w));
+      break;
+    default:
+      benchmark::DoNotOptimize(tree.insert(w));
+    }
+  }
+}
+BENCHMARK(Bench_TreeEditDuplicateInsert)
+    ->ArgName("mode")
+    ->Arg(0)
+    ->Arg(1)
+    ->Arg(2)
+    ->Unit(benchmark::kNanosecond);
+
+// Hashing every word of a 200000-word tree; mode 0 walks the node iterator, 1
+// and 2 the word views depth- and breadth-first, 3 parallel_for_each on 4
+// threads
+void Bench_TreeEditScan(benchmark::State &state) {
+  using tree_type = bk_tree::BKTree<bk_tree::metrics::EditDistance>;
+  tree_type tree;
+  for (auto const &w : generate_words(200000)) {
+    tree.insert(w);
+  }
+  auto hash = [](std::string_view w) {
+    benchmark::DoNotOptimize(std::hash<std::string_view>{}(w));
+  };
+  for (auto _ : state) {
+    switch (state.range(0)) {
+    case 0:
+      for (auto it = tree.begin(); it != tree.end(); ++it) {
+        hash((*it)->word());
+      }
+      break;
+    case 1:
+      std::ranges::for_each(tree.words(), hash);
+      break;
+    case 2:
+      std::ranges::for_each(tree.words<bk_tree::Traversal::breadth_first>(), hash);
+      break;
+    default:
+      tree.parallel_for_each(hash, 4);
+    }
+  }
+}
+BENCHMARK(Bench_TreeEditScan)
+    ->ArgName("mode")
+    ->DenseRange(0, 3)
+    ->Unit(benchmark::kMillisecond);
+
+void Bench_CachedTreeEditFind(benchmark::State &state) {
+  // range(0) distinct queries, so a cache of 1024 entries either always hits or
+  // always misses
+  bk_tree::CachedBKTree<bk_tree::metrics::EditDistance> tree(1024);
+  for (auto const &w : generate_words(20000)) {
+    tree.insert(w);
+  }
+  const auto queries = generate_words(state.range(0), 7);
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(tree.find(queries[i++ % queries.size()], 1));
+  }
+  state.counters["hits"] = tree.cache_hits();
+  state.counters["misses"] = tree.cache_misses();
+}
+BENCHMARK(Bench_CachedTreeEditFind)->Arg(16)->Arg(4096)->Unit(benchmark::kMicrosecond);
+
+void Bench_TreeEditFindFirstMatch(benchmark::State &state) {
+  bk_tree::BKTree<bk_tree::metrics::EditDistance> tree;
+  for (auto const &w : generate_words(20000)) {
+    tree.insert(w);
+  }
+  const auto queries = generate_words(256, 7);
+  size_t i = 0;
+  for (auto _ : state) {
+    auto const &query = queries[i++ % queries.size()];
+    if (state.range(0) == 0) {
+      auto results = tree.find(query, 3);
+      benchmark::DoNotOptimize(results.empty() ? nullptr : &results.front());
+    } else {
+      for (auto const &entry : tree.find_lazy(query, 3)) {
+        benchmark::DoNotOptimize(entry);
+        break;
+      }
+    }
+  }
+}
+BENCHMARK(Bench_TreeEditFindFirstMatch)
+    ->ArgName("lazy")
+    ->Arg(0)
+    ->Arg(1)
+    ->Unit(benchmark::kMicrosecond);
+
+// 0: insert every word of the other tree, 1: merge. Both trees hold 20000
+// words; with `shared` they were both started from the same 10000 words
+void Bench_TreeEditMerge(benchmark::State &state) {
+  const auto words = generate_words(40000);
+  const auto extra = generate_words(10000, 7);
+  using tree_type = bk_tree::BKTree<bk_tree::metrics::EditDistance>;
+  for (auto _ : state) {
+    state.PauseTiming();
+    tree_type target, source;
+    for (size_t i = 0; i < 20000; ++i) {
+      target.insert(words[i]);
+      source.insert(state.range(1) == 0 || i >= 10000 ? words[20000 + i]
+                                                      : words[i]);
+    }
+    if (state.range(1) != 0) {
+      for (auto const &w : extra) {
+        target.insert(w);
+      }
+    }
+    state.ResumeTiming();
+    if (state.range(0) == 0) {
+      for (auto it = source.begin(); it != source.end(); ++it) {
+        target.insert((*it)->word());
+      }
+    } else {
+      target.merge(std::move(source));
+    }
+    benchmark::DoNotOptimize(target.size());
+    state.PauseTiming();
+    target = tree_type();
+    source = tree_type();
+    state.ResumeTiming();
+  }
+}
+BENCHMARK(Bench_TreeEditMerge)
+    ->ArgNames({"merge", "shared"})
+    ->ArgsProduct({{0, 1}, {0, 1}})
+    ->Unit(benchmark::kMillisecond);
+
+// Erasing a share (in percent) of a 20000-word tree by looping over erase (0)
+// or with one erase_many (1)
+void Bench_TreeEditEraseMany(benchmark::State &state) {
+  const auto words = generate_words(20000);
+  std::vector<std::string> victims;
+  for (size_t i = 0; i < words.size(); i += 100) {
+    for (size_t j = 0; j < static_cast<size_t>(state.range(0)); ++j) {
+      victims.push_back(words[i + j]);
+    }
+  }
+  for (auto _ : state) {
+    state.PauseTiming();
+    bk_tree::BKTree<bk_tree::metrics::EditDistance> tree;
+    for (auto const &w : words) {
+      tree.insert(w);
+    }
+    state.ResumeTiming();
+    if (state.range(1) == 0) {
+      for (auto const &v : victims) {
+        tree.erase(v);
+      }
+    } else {
+      tree.erase_many(victims);
+    }
+    benchmark::DoNotOptimize(tree.size());
+    state.PauseTiming();
+    tree = {};
+    state.ResumeTiming();
+  }
+}
+BENCHMARK(Bench_TreeEditEraseMany)
+    ->ArgNames({"percent", "batched"})
+    ->ArgsProduct({{1, 10, 50}, {0, 1}})
+    ->Unit(benchmark::kMillisecond);
+
+// Finds after erasing the oldest quarter of a 20000-word ConcurrentBKTree,
+// which leaves tombstones behind; 1: rebuilt afterwards
+void Bench_ConcurrentTreeEditFindAfterErase(benchmark::State &state) {
+  const auto words = generate_words(20000);
+  bk_tree::ConcurrentBKTree<bk_tree::metrics::EditDistance> tree;
+  tree.set_rebuild_policy({0, 0});
+  for (auto const &w : words) {
+    tree.insert(w);
+  }
+  for (size_t i = 0; i < words.size() / 4; ++i) {
+    tree.erase(words[i]);
+  }
+  state.counters["degradation"] = tree.degradation();
+  if (state.range(0) != 0) {
+    tree.rebuild();
+  }
+  const auto queries = generate_words(256, 7);
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(tree.find(queries[i++ % queries.size()], 2));
+  }
+}
+BENCHMARK(Bench_ConcurrentTreeEditFindAfterErase)
+    ->ArgName("rebuilt")
+    ->Arg(0)
+    ->Arg(1)
+    ->Unit(benchmark::kMicrosecond);
+
+// DamerauLevenshteinDistance that counts its evaluations
+struct CountingDamerau : bk_tree::metrics::Distance<CountingDamerau> {
+  using sketch_type = bk_tree::metrics::WordSketch;
+  static inline size_t evaluations = 0;
+  bk_tree::metrics::DamerauLevenshteinDistance metric;
+
+  bk_tree::integer_type compute_distance(std::string_view s, std::string_view t) const {
+    ++evaluations;
+    return metric(s, t);
+  }
+  bk_tree::integer_type lower_bound(const sketch_type &s, const sketch_type &t) const {
+    return metric.lower_bound(s, t);
+  }
+  bk_tree::integer_type upper_bound(const sketch_type &s, const sketch_type &t) const {
+    return metric.upper_bound(s, t);
+  }
+};
+
+// Misspelled queries against 20000 two-word phrases with range(1) pivots.
+// evaluations is the metric calls per query, pivot calls included
+void Bench_TreeDamerauFindPivots(benchmark::State &state) {
+  auto words = generate_dictionary(20000);
+  const auto second = generate_dictionary(words.size(), 3);
+  for (size_t i = 0; i < words.size(); ++i) {
+    words[i] += second[i];
+  }
+  bk_tree::BKTree<CountingDamerau> tree;
+  for (auto const &w : words) {
+    tree.insert(w);
+  }
+  tree.select_pivots(state.range(1));
+  const auto queries = misspell(words, 256);
+  CountingDamerau::evaluations = 0;
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(tree.find(queries[i++ % queries.size()], state.range(0)));
+  }
+  state.counters["evaluations"] =
+      static_cast<double>(CountingDamerau::evaluations) / state.iterations();
+}
+BENCHMARK(Bench_TreeDamerauFindPivots)
+    ->ArgNames({"limit", "pivots"})
+    ->ArgsProduct({{2, 3}, {0, 4, 8, 16}})
+    ->Unit(benchmark::kMicrosecond);
+
+// Misspelled queries against a 50000-word dictionary with an evaluation budget
+// (0: unbounded). recall is the share of find's matches returned, nearest the
+// share of queries whose closest match was among them
+void Bench_TreeEditFindBounded(benchmark::State &state) {
+  const auto words = generate_dictionary(50000);
+  bk_tree::BKTree<bk_tree::metrics::EditDistance> tree;
+  for (auto const &w : words) {
+    tree.insert(w);
+  }
+  const auto queries = misspell(words, 256);
+  std::vector<size_t> matches;
+  std::vector<int> closest;
+  for (auto const &query : queries) {
+    auto exact = tree.find_bounded(query, 2, {});
+    matches.push_back(exact.results.size());
+    closest.push_back(exact.results.empty() ? -1 : exact.results.front().second);
+  }
+  bk_tree::SearchBudget budget;
+  if (state.range(0) > 0) {
+    budget.max_evaluations = state.range(0);
+  }
+  size_t i = 0, found = 0, expected = 0, nearest = 0, complete = 0;
+  for (auto _ : state) {
+    const size_t q = i++ % queries.size();
+    auto bounded = tree.find_bounded(queries[q], 2, budget);
+    found += bounded.results.size();
+    expected += matches[q];
+    auto const &results = bounded.results;
+    nearest += closest[q] < 0 ||
+               (!results.empty() && results.front().second == closest[q]);
+    complete += bounded.complete;
+  }
+  state.counters["recall"] =
+      expected == 0 ? 1.0 : static_cast<double>(found) / expected;
+  state.counters["nearest"] = static_cast<double>(nearest) / i;
+  state.counters["complete"] = static_cast<double>(complete) / i;
+}
+BENCHMARK(Bench_TreeEditFindBounded)
+    ->ArgName("evaluations")
+    ->Arg(250)
+    ->Arg(1000)
+    ->Arg(4000)
+    ->Arg(0)
+    ->Unit(benchmark::kMicrosecond);
+
+// Counts the bytes outstanding from the default resource
+class CountingResource : public std::pmr::memory_resource {
+public:
+  size_t bytes = 0;
+
+private:
+  void *do_allocate(size_t size, size_t alignment) override {
+    bytes += size;
+    return std::pmr::get_default_resource()->allocate(size, alignment);
+  }
+  void do_deallocate(void *p, size_t size, size_t alignment) override {
+    bytes -= size;
+    std::pmr::get_default_resource()->deallocate(p, size, alignment);
+  }
+  bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+    return this == &other;
+  }
+};
+
+// Misspelled queries at radius 1 against a 200000-word dictionary as a BKTree
+// (0) and front-coded as a CompactBKTree (1), with the bytes each holds per word
+void Bench_CompactTreeEditFind(benchmark::State &state) {
+  const auto words = generate_dictionary(200000);
+  CountingResource resource;
+  bk_tree::BKTree<bk_tree::metrics::EditDistance> tree(&resource);
+  for (auto const &w : words) {
+    tree.insert(w);
+  }
+  const bk_tree::CompactBKTree<bk_tree::metrics::EditDistance> compact(tree);
+  const auto queries = misspell(words, 256);
+  size_t i = 0;
+  for (auto _ : state) {
+    auto const &query = queries[i++ % queries.size()];
+    if (state.range(0) == 0) {
+      benchmark::DoNotOptimize(tree.find(query, 1));
+    } else {
+      benchmark::DoNotOptimize(compact.find(query, 1));
+    }
+  }
+  const size_t bytes = state.range(0) == 0 ? resource.bytes : compact.memory_usage();
+  state.counters["bytes_per_word"] = static_cast<double>(bytes) / words.size();
+}
+BENCHMARK(Bench_CompactTreeEditFind)
+    ->ArgName("compact")
+    ->Arg(0)
+    ->Arg(1)
+    ->Unit(benchmark::kMicrosecond);
+
+// Misspelled queries against a 50000-word dictionary by radius; 0: BKTree,
+// 1: QGramIndex with bigrams, 2: QGramIndex with trigrams
+void Bench_EditIndexByRadius(benchmark::State &state) {
+  const auto words = generate_dictionary(50000);
+  const auto queries = misspell(words, 256);
+  const int limit = static_cast<int>(state.range(0));
+  auto run = [&](auto &index) {
+    for (auto const &w : words) {
+      index.insert(w);
+    }
+    size_t i = 0;
+    for (auto _ : state) {
+      benchmark::DoNotOptimize(index.find(queries[i++ % queries.size()], limit));
+    }
+  };
+  if (state.range(1) == 0) {
+    bk_tree::BKTree<bk_tree::metrics::EditDistance> tree;
+    run(tree);
+  } else if (state.range(1) == 1) {
+    bk_tree::QGramIndex<bk_tree::metrics::EditDistance, 2> index;
+    run(index);
+  } else {
+    bk_tree::QGramIndex<bk_tree::metrics::EditDistance, 3> index;
+    run(index);
+  }
+}
+BENCHMARK(Bench_EditIndexByRadius)
+    ->ArgNames({"radius", "qgram"})
+    ->ArgsProduct({{1, 2, 3, 4}, {0, 1, 2}})
+    ->Unit(benchmark::kMicrosecond);
+
+// Hamming queries over 50000 words of lengths 4 to 12; 0: one BKTree, which
+// only keeps the words as long as its root, 1: LengthBKForest
+void Bench_HammingMixedLengths(benchmark::State &state) {
+  const auto words = generate_words(50000);
+  const auto queries = generate_words(256, 7);
+  auto run = [&](auto &index) {
+    for (auto const &w : words) {
+      index.insert(w);
+    }
+    size_t matches = 0;
+    for (auto const &query : queries) {
+      matches += index.find(query, 2).size();
+    }
+    state.counters["indexed"] = static_cast<double>(index.size());
+    state.counters["matches"] = static_cast<double>(matches) / queries.size();
+    size_t i = 0;
+    for (auto _ : state) {
+      benchmark::DoNotOptimize(index.find(queries[i++ % queries.size()], 2));
+    }
+  };
+  if (state.range(0) == 0) {
+    bk_tree::BKTree<bk_tree::metrics::HammingDistance> tree;
+    run(tree);
+  } else {
+    bk_tree::LengthBKForest<bk_tree::metrics::HammingDistance> forest;
+    run(forest);
+  }
+}
+BENCHMARK(Bench_HammingMixedLengths)
+    ->ArgName("partitioned")
+    ->Arg(0)
+    ->Arg(1)
+    ->Unit(benchmark::kMicrosecond);
+
+// 0: one find per query, 1: find_batch over all queries
+void Bench_TreeEditFindBatch(benchmark::State &state) {
+  bk_tree::BKTree<bk_tree::metrics::EditDistance> tree;
+  for (auto const &w : generate_words(50000)) {
+    tree.insert(w);
+  }
+  const auto queries = generate_words(256, 7);
+  for (auto _ : state) {
+    if (state.range(0) == 0) {
+      for (auto const &query : queries) {
+        benchmark::DoNotOptimize(tree.find(query, 2));
+      }
+    } else {
+      benchmark::DoNotOptimize(tree.find_batch(queries, 2));
+    }
+  }
+}
+BENCHMARK(Bench_TreeEditFindBatch)
+    ->ArgName("batch")
+    ->Arg(0)
+    ->Arg(1)
+    ->Unit(benchmark::kMillisecond);
+
+// All pairs within range(0) between two 10000-word dictionaries (range(1) 0:
+// a find for every word of one, 1: similarity_join) or within one (2: a find
+// for every word, 3: self_join), on one thread
+void Bench_TreeEditJoin(benchmark::State &state) {
+  using tree_type = bk_tree::BKTree<bk_tree::metrics::EditDistance>;
+  tree_type a, b;
+  for (auto const &w : generate_dictionary(10000)) {
+    a.insert(w);
+  }
+  for (auto const &w : generate_dictionary(10000, 3)) {
+    b.insert(w);
+  }
+  const int limit = static_cast<int>(state.range(0));
+  size_t pairs = 0;
+  auto count = [&pairs](std::string_view, std::string_view, int) { ++pairs; };
+  for (auto _ : state) {
+    switch (state.range(1)) {
+    case 0:
+      for (auto w : a.words()) {
+        pairs += b.find(w, limit).size();
+      }
+      break;
+    case 1:
+      bk_tree::similarity_join(a, b, limit, count, 1);
+      break;
+    case 2:
+      for (auto w : a.words()) {
+        pairs += a.find(w, limit).size();
+      }
+      break;
+    default:
+      bk_tree::self_join(a, limit, count, 1);
+    }
+  }
+  state.counters["pairs"] = static_cast<double>(pairs) / state.iterations();
+}
+BENCHMARK(Bench_TreeEditJoin)
+    ->ArgNames({"limit", "mode"})
+    ->ArgsProduct({{1, 2}, {0, 1, 2, 3}})
+    ->Unit(benchmark::kMillisecond);
+
+// Resident memory not backed by files, i.e. without the mapped dictionary
+static size_t anonymous_bytes() {
+  size_t pages = 0, resident = 0, shared = 0;
+  std::ifstream("/proc/self/statm") >> pages >> resident >> shared;
+  return (resident - shared) * static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+}
+
+// 0: getline and insert, 1: load_dictionary, 2: load_dictionary on 4 threads
+void Bench_TreeLoadDictionary(benchmark::State &state) {
+  const auto path = std::filesystem::temp_directory_path() / "bktree_bench_words.txt";
+  {
+    std::ofstream file(path);
+    for (auto const &w : generate_words(500000)) {
+      file << w << '\n';
+    }
+  }
+  for (auto _ : state) {
+    const size_t before = anonymous_bytes();
+    bk_tree::BKTree<bk_tree::metrics::EditDistance> tree;
+    if (state.range(0) == 0) {
+      std::ifstream file(path);
+      for (std::string line; std::getline(file, line);) {
+        tree.insert(line);
+      }
+    } else {
+      tree = bk_tree::load_dictionary<bk_tree::metrics::EditDistance>(
+          path, state.range(0) == 1 ? 1 : 4);
+    }
+    state.PauseTiming();
+    state.counters["anon_rss_mb"] = (anonymous_bytes() - before) / 1e6;
+    state.ResumeTiming();
+  }
+  std::filesystem::remove(path);
+}
+BENCHMARK(Bench_TreeLoadDictionary)
+    ->ArgName("mode")
+    ->DenseRange(0, 2)
+    ->Iterations(1)
+    ->Unit(benchmark::kMillisecond);
+
+// 0: rebuild by inserting every word, 1: reopen a DurableBKTree whose snapshot
+// holds every word, followed by a 1000-record log
+void Bench_TreeEditRecovery(benchmark::State &state) {
+  const auto words = generate_words(state.range(0));
+  const auto directory =
+      std::filesystem::temp_directory_path() / "bktree_bench_durable";
+  std::filesystem::remove_all(directory);
+  {
+    bk_tree::BKTree<bk_tree::metrics::EditDistance> tree;
+    for (auto const &w : words) {
+      tree.insert(w);
+    }
+    bk_tree::DurableBKTree<bk_tree::metrics::EditDistance> durable(directory);
+    durable.reset(std::move(tree));
+    for (auto const &w : generate_words(1000, 7)) {
+      durable.insert(w);
+    }
+  }
+  for (auto _ : state) {
+    if (state.range(1) == 0) {
+      bk_tree::BKTree<bk_tree::metrics::EditDistance> tree;
+      for (auto const &w : words) {
+        tree.insert(w);
+      }
+      benchmark::DoNotOptimize(tree.size());
+    } else {
+      bk_tree::DurableBKTree<bk_tree::metrics::EditDistance> durable(directory);
+      benchmark::DoNotOptimize(durable.size());
+    }
+  }
+  std::filesystem::remove_all(directory);
+}
+BENCHMARK(Bench_TreeEditRecovery)
+    ->ArgNames({"words", "durable"})
+    ->ArgsProduct({{20000, 200000}, {0, 1}})
+    ->Unit(benchmark::kMillisecond);
+
+// 0: default resource, 1: monotonic buffer, 2: monotonic buffer and abandon()
+void Bench_TreeHammingTeardown(benchmark::State &state) {
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<int> letter('a', 'd');
+  std::vector<std::string> words(1 << 20, std::string(16, ' '));
+  for (auto &w : words) {
+    for (auto &c : w) {
+      c = static_cast<char>(letter(rng));
+    }
+  }
+  for (auto _ : state) {
+    state.PauseTiming();
+    std::pmr::monotonic_buffer_resource buffer;
+    std::pmr::memory_resource *resource =
+        state.range(0) == 0 ? std::pmr::get_default_resource() : &buffer;
+    auto tree = std::make_unique<bk_tree::BKTree<bk_tree::metrics::HammingDistance>>(
+        bk_tree::metrics::HammingDistance(), resource);
+    for (auto const &w : words) {
+      tree->insert(w);
+    }
+    state.ResumeTiming();
+    if (state.range(0) == 2) {
+      tree->abandon();
+    }
+    tree.reset();
+    buffer.release();
+  }
+}
+BENCHMARK(Bench_TreeHammingTeardown)
+    ->ArgName("resource")
+    ->DenseRange(0, 2)
+    ->Iterations(3)
+    ->Unit(benchmark::kMillisecond);
+
 int main(int argc, char **argv) {
   benchmark::Initialize(&argc, argv);
   benchmark::RunSpecifiedBenchmarks();
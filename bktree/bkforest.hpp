@@ -0,0 +1,276 @@
+//
+// bk-tree   Header-only Burkhard-Keller tree library
+// Copyright (C) 2020-2023  John Law
+//
+// This file is part of bk-tree.
+//
+// bk-tree is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// bk-tree is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with bk-tree.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include "bktree.hpp"
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace bk_tree {
+
+namespace helpers {
+
+/**
+ * @brief Fixed-size thread pool used to fan queries out across shards
+ */
+class ThreadPool {
+public:
+  explicit ThreadPool(size_t thread_count) {
+    m_workers.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i) {
+      m_workers.emplace_back([this] { run(); });
+    }
+  }
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  ~ThreadPool() {
+    {
+      std::lock_guard lock(m_mutex);
+      m_stopping = true;
+    }
+    m_condition.notify_all();
+    for (auto &worker : m_workers) {
+      worker.join();
+    }
+  }
+
+  template <typename Function>
+  auto submit(Function &&function) -> std::future<decltype(function())> {
+    using result_type = decltype(function());
+    auto task = std::make_shared<std::packaged_task<result_type()>>(
+        std::forward<Function>(function));
+    auto future = task->get_future();
+    {
+      std::lock_guard lock(m_mutex);
+      m_tasks.emplace([task] { (*task)(); });
+    }
+    m_condition.notify_one();
+    return future;
+  }
+
+  size_t size() const noexcept { return m_workers.size(); }
+
+private:
+  void run() {
+    for (;;) {
+      std::function<void()> task;
+      {
+        std::unique_lock lock(m_mutex);
+        m_condition.wait(lock, [this] { return m_stopping || !m_tasks.empty(); });
+        if (m_tasks.empty()) {
+          return;
+        }
+        task = std::move(m_tasks.front());
+        m_tasks.pop();
+      }
+      task();
+    }
+  }
+
+  std::vector<std::thread> m_workers;
+  std::queue<std::function<void()>> m_tasks;
+  std::mutex m_mutex;
+  std::condition_variable m_condition;
+  bool m_stopping = false;
+};
+
+} // namespace helpers
+
+/**
+ * @brief Sharded BK-forest
+ *
+ * Words are partitioned by hash across independent BKTree shards. Inserts and
+ * erases touch only the owning shard, while a single find is fanned out over
+ * all shards in parallel and the partial results are concatenated. The calling
+ * thread searches the first shard itself, so a forest of \f$n\f$ shards keeps
+ * \f$n - 1\f$ worker threads.
+ */
+template <typename Metric>
+class BKForest {
+  static_assert(helpers::is_metric<Metric>::value, "Metric must be of type Distance");
+
+  using metric_type = Metric;
+  using tree_type = BKTree<metric_type>;
+
+public:
+  explicit BKForest(size_t shard_count = std::thread::hardware_concurrency(),
+                    const metric_type &distance = Metric())
+      : m_metric(distance),
+        m_shards(std::max<size_t>(shard_count, 1), tree_type(distance)),
+        m_pool(std::make_unique<helpers::ThreadPool>(m_shards.size() - 1)) {}
+
+  BKForest(std::initializer_list<std::string_view> list,
+           size_t shard_count = std::thread::hardware_concurrency())
+      : BKForest(shard_count) {
+    for (auto &str : list) {
+      insert(str);
+    }
+  }
+
+  BKForest(const BKForest &) = delete;
+  BKForest &operator=(const BKForest &) = delete;
+
+  /**
+   * @brief Takes over the shards of `other`, which is left an empty forest of
+   * one shard
+   */
+  BKForest(BKForest &&other) : BKForest(1, other.m_metric) {
+    std::swap(m_metric, other.m_metric);
+    std::swap(m_shards, other.m_shards);
+    std::swap(m_pool, other.m_pool);
+  }
+
+  BKForest &operator=(BKForest &&other) noexcept {
+    std::swap(m_metric, other.m_metric);
+    std::swap(m_shards, other.m_shards);
+    std::swap(m_pool, other.m_pool);
+    return *this;
+  }
+  ~BKForest() = default;
+
+  bool insert(std::string_view value) {
+    return m_shards[shard_of(value)].insert(value);
+  }
+  bool erase(std::string_view value) { return m_shards[shard_of(value)].erase(value); }
+  size_t size() const noexcept;
+  bool empty() const noexcept { return size() == 0; }
+  size_t shard_count() const noexcept { return m_shards.size(); }
+  const tree_type &shard(size_t index) const { return m_shards.at(index); }
+  [[nodiscard]] ResultList find(std::string_view value, int limit) const;
+
+private:
+  size_t shard_of(std::string_view value) const noexcept {
+    return std::hash<std::string_view>{}(value) % m_shards.size();
+  }
+
+  metric_type m_metric;
+  std::vector<tree_type> m_shards;
+  std::unique_ptr<helpers::ThreadPool> m_pool;
+};
+
+template <typename Metric>
+size_t BKForest<Metric>::size() const noexcept {
+  size_t total = 0;
+  for (auto const &shard : m_shards) {
+    total += shard.size();
+  }
+  return total;
+}
+
+template <typename Metric>
+ResultList BKForest<Metric>::find(std::string_view value, int limit) const {
+  std::vector<std::future<ResultList>> pending;
+  pending.reserve(m_shards.size() - 1);
+  for (size_t i = 1; i < m_shards.size(); ++i) {
+    if (!m_shards[i].empty()) {
+      pending.push_back(m_pool->submit(
+          [this, i, value, limit] { return m_shards[i].find(value, limit); }));
+    }
+  }
+  ResultList output = m_shards[0].find(value, limit);
+  for (auto &future : pending) {
+    ResultList partial = future.get();
+    output.insert(output.end(), std::make_move_iterator(partial.begin()),
+                  std::make_move_iterator(partial.end()));
+  }
+  return output;
+}
+
+/**
+ * @brief Forest of one BKTree per word length, for metrics only defined between
+ * words of the same length
+ *
+ * HammingDistance and LeeDistance return the maximum distance across lengths,
+ * which a single BKTree rejects on insert and still computes for every node a
+ * query visits. Here insert, erase and find go straight to the tree of their
+ * word's length, so a dictionary may mix lengths and no distance across
+ * lengths is ever computed.
+ */
+template <typename Metric>
+class LengthBKForest {
+  static_assert(helpers::is_metric<Metric>::value, "Metric must be of type Distance");
+  static_assert(helpers::is_fixed_length<Metric>::value,
+                "Metric must only compare words of the same length");
+
+  using metric_type = Metric;
+  using tree_type = BKTree<metric_type>;
+
+public:
+  explicit LengthBKForest(const metric_type &distance = Metric())
+      : m_metric(distance) {}
+
+  LengthBKForest(std::initializer_list<std::string_view> list) : LengthBKForest() {
+    for (auto &str : list) {
+      insert(str);
+    }
+  }
+
+  bool insert(std::string_view value) {
+    auto it = m_partitions.try_emplace(value.size(), m_metric).first;
+    const bool inserted = it->second.insert(value);
+    m_size += inserted;
+    return inserted;
+  }
+  bool erase(std::string_view value);
+  size_t size() const noexcept { return m_size; }
+  bool empty() const noexcept { return m_size == 0; }
+  size_t partition_count() const noexcept { return m_partitions.size(); }
+  /**
+   * @brief The tree holding the words of `length`, or nullptr if there are none
+   */
+  const tree_type *partition(size_t length) const {
+    auto it = m_partitions.find(length);
+    return it == m_partitions.end() ? nullptr : &it->second;
+  }
+  [[nodiscard]] ResultList find(std::string_view value, int limit) const {
+    const tree_type *tree = partition(value.size());
+    return tree == nullptr ? ResultList{} : tree->find(value, limit);
+  }
+
+private:
+  const metric_type m_metric;
+  std::map<size_t, tree_type> m_partitions;
+  size_t m_size = 0;
+};
+
+template <typename Metric>
+bool LengthBKForest<Metric>::erase(std::string_view value) {
+  auto it = m_partitions.find(value.size());
+  if (it == m_partitions.end() || !it->second.erase(value)) {
+    return false;
+  }
+  --m_size;
+  if (it->second.empty()) {
+    m_partitions.erase(it);
+  }
+  return true;
+}
+
+} // namespace bk_tree
@@ -32,17 +32,57 @@
 #ifndef BK_LEE_ALPHABET_SIZE
 #define BK_LEE_ALPHABET_SIZE 26
 #endif
+#ifndef BK_DP_DIAGONAL_MIN_LENGTH
+#define BK_DP_DIAGONAL_MIN_LENGTH 12
+#endif
+
 #ifndef BK_TREE_INITIAL_SIZE
 #define BK_TREE_INITIAL_SIZE 0
 #endif
+#ifndef BK_REBUILD_DEGRADATION
+#define BK_REBUILD_DEGRADATION 0.25
+#endif
+#ifndef BK_REBUILD_MIN_SIZE
+#define BK_REBUILD_MIN_SIZE 1024
+#endif
+#ifndef BK_PIVOT_COUNT
+#define BK_PIVOT_COUNT 4
+#endif
+#ifndef BK_PIVOT_CANDIDATES
+#define BK_PIVOT_CANDIDATES 1024
+#endif
+#ifndef BK_PARALLEL_SUBTREES
+#define BK_PARALLEL_SUBTREES 4
+#endif
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <concepts>
+#include <coroutine>
 #include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <istream>
 #include <iterator>
 #include <limits>
 #include <map>
 #include <memory>
+#include <memory_resource>
+#include <optional>
+#include <ostream>
 #include <queue>
+#include <random>
+#include <ranges>
+#include <span>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -58,8 +98,115 @@ using integer_type = std::uint64_t;
  */
 namespace metrics {
 
+/**
+ * @brief Cheap summary of a word consulted by metric bounds
+ *
+ * The signature has one bit per character class: each of `a-z`, `A-Z` and
+ * `0-9` owns a bit, and all remaining bytes share the last two bits.
+ */
+struct WordSketch {
+  integer_type length = 0;
+  std::uint64_t signature = 0;
+
+  WordSketch() = default;
+  explicit WordSketch(std::string_view s) noexcept : length(s.length()) {
+    for (unsigned char c : s) {
+      signature |= std::uint64_t{1} << bucket(c);
+    }
+  }
+
+  static constexpr unsigned bucket(unsigned char c) noexcept {
+    if (c >= 'a' && c <= 'z') {
+      return c - 'a';
+    }
+    if (c >= 'A' && c <= 'Z') {
+      return 26 + (c - 'A');
+    }
+    if (c >= '0' && c <= '9') {
+      return 52 + (c - '0');
+    }
+    return 62 + (c & 1);
+  }
+
+  /**
+   * @brief Number of character classes present in one sketch but not the other
+   */
+  friend integer_type missing_classes(const WordSketch &s,
+                                      const WordSketch &t) noexcept {
+    return std::max(std::popcount(s.signature & ~t.signature),
+                    std::popcount(t.signature & ~s.signature));
+  }
+};
+
+namespace helpers {
+/**
+ * @brief Per-thread scratch storage of a metric
+ *
+ * Shared by every instance of `Metric` on the calling thread, so that a const
+ * metric (and therefore BKTree::find) can be used from several threads at once.
+ */
+template <typename Metric, typename Storage>
+Storage &thread_scratch() noexcept {
+  thread_local Storage storage;
+  return storage;
+}
+
+/**
+ * @brief `count` contiguous DP rows of `width` cells from the thread's scratch
+ */
+template <typename Metric, typename Cell>
+Cell *scratch_rows(size_t count, size_t width) {
+  auto &rows = thread_scratch<Metric, std::vector<Cell>>();
+  if (rows.size() < count * width) {
+    rows.resize(count * width);
+  }
+  return rows.data();
+}
+
+/**
+ * @brief `t` reversed into the thread's scratch
+ *
+ * Anti-diagonal kernels walk `t` backwards; reading a reversed copy forwards
+ * keeps their inner loops vectorizable.
+ */
+template <typename Metric>
+const char *reversed(std::string_view t) {
+  auto &copy = thread_scratch<Metric, std::string>();
+  copy.assign(t.rbegin(), t.rend());
+  return copy.data();
+}
+
+/**
+ * @brief Calls `kernel` with the narrowest cell type able to hold `bound + 1`
+ *
+ * Narrow cells let the row updates run on 16 or 32 lanes per vector register.
+ */
+template <typename Kernel>
+integer_type with_cell_type(integer_type bound, Kernel &&kernel) {
+  if (bound < std::numeric_limits<std::uint8_t>::max()) {
+    return kernel(std::uint8_t{});
+  }
+  if (bound < std::numeric_limits<std::uint16_t>::max()) {
+    return kernel(std::uint16_t{});
+  }
+  if (bound < std::numeric_limits<std::uint32_t>::max()) {
+    return kernel(std::uint32_t{});
+  }
+  return kernel(integer_type{});
+}
+} // namespace helpers
+
 /**
  * @brief Metric interface for string distances
+ *
+ * A metric may additionally expose `lower_bound(const WordSketch &, const
+ * WordSketch &)` and `upper_bound(...)`. When both are present, BKTree::find
+ * consults them before the full distance evaluation.
+ *
+ * A search compares one query with many words, so it first calls `prepare` on
+ * the query. The default Prepared only keeps the query; a metric with costly
+ * query-side setup declares its own `Prepared` and `prepare`, with the same
+ * members, that do the setup once.
  */
 template <typename Metric>
 class Distance {
@@ -67,6 +214,35 @@ public:
   integer_type operator()(std::string_view s, std::string_view t) const {
     return (static_cast<Metric const *>(this))->compute_distance(s, t);
   }
+
+  /**
+   * @brief A query set up for evaluations against many words
+   *
+   * `prepared(t)` equals `metric(query, t)`, and `batch` evaluates a whole list
+   * of words at once. The metric and the query must outlive it.
+   */
+  class Prepared {
+  public:
+    Prepared(const Metric &metric, std::string_view query) noexcept
+        : m_metric(&metric), m_query(query) {}
+    std::string_view query() const noexcept { return m_query; }
+    integer_type operator()(std::string_view t) const {
+      return (*m_metric)(m_query, t);
+    }
+    void batch(std::span<const std::string_view> words,
+               std::span<integer_type> output) const {
+      for (size_t i = 0; i < words.size(); ++i) {
+        output[i] = (*this)(words[i]);
+      }
+    }
+
+  private:
+    const Metric *m_metric;
+    std::string_view m_query;
+  };
+  Prepared prepare(std::string_view query) const noexcept {
+    return Prepared(static_cast<Metric const &>(*this), query);
+  }
 };
 
 /**
@@ -141,32 +317,87 @@ public:
  * for any \f$0\le i < m\f$ and \f$0\le j < n.\f$
  */
 class LCSubseqDistance final : public Distance<LCSubseqDistance> {
-  mutable std::vector<integer_type> m_current, m_previous;
-
 public:
-  explicit LCSubseqDistance(size_t initial_size = BK_LCS_MATRIX_INITIAL_SIZE)
-      : m_current(initial_size), m_previous(initial_size){};
+  explicit LCSubseqDistance(size_t initial_size = BK_LCS_MATRIX_INITIAL_SIZE) {
+    helpers::scratch_rows<LCSubseqDistance, std::uint8_t>(2, initial_size);
+  };
+  integer_type lower_bound(const WordSketch &s, const WordSketch &t) const noexcept {
+    constexpr std::uint64_t exact_classes = (std::uint64_t{1} << 62) - 1;
+    return (s.signature & t.signature & exact_classes) != 0;
+  }
+  integer_type upper_bound(const WordSketch &s, const WordSketch &t) const noexcept {
+    return std::min(s.length, t.length);
+  }
   integer_type compute_distance(std::string_view s, std::string_view t) const noexcept {
-    const integer_type M = s.length(), N = t.length();
-    if (M == 0 || N == 0) {
+    if (s.empty() || t.empty()) {
       return 0;
     }
-    if (m_current.size() <= N || m_previous.size() <= N) {
-      m_current.resize(N + 1);
-      m_previous.resize(N + 1);
+    const size_t shorter = std::min(s.length(), t.length());
+    return helpers::with_cell_type(shorter, [&](auto cell) {
+      return shorter < BK_DP_DIAGONAL_MIN_LENGTH ? row_kernel(s, t, cell)
+                                                 : diagonal_kernel(s, t, cell);
+    });
+  }
+
+private:
+  /**
+   * Row \f$i\f$ is \f$\max\{L_{i-1,j},\ L_{i-1,j-1} + [x_i = y_j]\}\f$, which
+   * only reads the previous row and vectorizes, followed by a running maximum
+   * that supplies the \f$L_{i,j-1}\f$ term.
+   */
+  template <typename Cell>
+  static integer_type row_kernel(std::string_view s, std::string_view t,
+                                 Cell) noexcept {
+    const size_t M = s.length(), N = t.length();
+    Cell *previous = helpers::scratch_rows<LCSubseqDistance, Cell>(2, N + 1);
+    Cell *current = previous + N + 1;
+    std::fill_n(previous, N + 1, Cell{0});
+    current[0] = 0;
+    for (size_t i = 1; i <= M; ++i) {
+      const char a = s[i - 1];
+      for (size_t j = 1; j <= N; ++j) {
+        current[j] = std::max(previous[j], static_cast<Cell>(previous[j - 1] +
+                                                              (a == t[j - 1])));
+      }
+      for (size_t j = 1; j <= N; ++j) {
+        current[j] = std::max(current[j], current[j - 1]);
+      }
+      std::swap(previous, current);
     }
-    std::fill(m_previous.begin(), m_previous.end(), 0);
-    for (integer_type i = 1; i <= M; ++i) {
-      for (integer_type j = 1; j <= N; ++j) {
-        if (s[i - 1] == t[j - 1]) {
-          m_current[j] = m_previous[j - 1] + 1;
-        } else {
-          m_current[j] = std::max(m_previous[j], m_current[j - 1]);
-        }
+    return previous[N];
+  }
+
+  /**
+   * Cells on the anti-diagonal \f$i + j = k\f$ depend only on diagonals
+   * \f$k - 1\f$ and \f$k - 2\f$, so each diagonal (indexed by \f$i\f$) is one
+   * independent, vectorizable loop.
+   */
+  template <typename Cell>
+  static integer_type diagonal_kernel(std::string_view s, std::string_view t,
+                                      Cell) noexcept {
+    const size_t M = s.length(), N = t.length();
+    Cell *older = helpers::scratch_rows<LCSubseqDistance, Cell>(3, M + 1);
+    Cell *old = older + M + 1, *current = old + M + 1;
+    const char *r = helpers::reversed<LCSubseqDistance>(t);
+    older[0] = 0;
+    old[0] = old[1] = 0;
+    for (size_t k = 2; k <= M + N; ++k) {
+      const size_t first = k > N ? k - N : 1, last = std::min(M, k - 1);
+      for (size_t i = first; i <= last; ++i) {
+        const bool match = s[i - 1] == r[N - k + i];
+        current[i] =
+            std::max({old[i - 1], old[i], static_cast<Cell>(older[i - 1] + match)});
+      }
+      if (k <= N) {
+        current[0] = 0;
+      }
+      if (k <= M) {
+        current[k] = 0;
       }
-      m_previous = m_current;
+      std::swap(older, old);
+      std::swap(old, current);
     }
-    return m_previous[N];
+    return old[M];
   }
 };
 
@@ -219,35 +450,189 @@ public:
  * for any \f$0\le i < m\f$ and \f$0\le j < n.\f$
  */
 class EditDistance final : public Distance<EditDistance> {
-  mutable std::vector<std::vector<integer_type>> m_matrix;
-
 public:
-  explicit EditDistance(size_t initial_size = BK_ED_MATRIX_INITIAL_SIZE)
-      : m_matrix(initial_size, std::vector<integer_type>(initial_size)){};
+  explicit EditDistance(size_t initial_size = BK_ED_MATRIX_INITIAL_SIZE) {
+    helpers::scratch_rows<EditDistance, std::uint8_t>(2, initial_size);
+  };
+  integer_type lower_bound(const WordSketch &s, const WordSketch &t) const noexcept {
+    const integer_type length_difference =
+        s.length > t.length ? s.length - t.length : t.length - s.length;
+    return std::max(length_difference, missing_classes(s, t));
+  }
+  integer_type upper_bound(const WordSketch &s, const WordSketch &t) const noexcept {
+    return std::max(s.length, t.length);
+  }
   integer_type compute_distance(std::string_view s, std::string_view t) const noexcept {
-    const integer_type M = s.length(), N = t.length();
-    if (M == 0 || N == 0) {
-      return N + M;
+    if (s.empty() || t.empty()) {
+      return s.length() + t.length();
     }
-    if (m_matrix.size() <= M || m_matrix[0].size() <= N) {
-      std::vector<std::vector<integer_type>> a_matrix(M + 1,
-                                                      std::vector<integer_type>(N + 1));
-      m_matrix.swap(a_matrix);
+    const size_t shorter = std::min(s.length(), t.length());
+    return helpers::with_cell_type(std::max(s.length(), t.length()), [&](auto cell) {
+      return shorter < BK_DP_DIAGONAL_MIN_LENGTH ? row_kernel(s, t, cell)
+                                                 : diagonal_kernel(s, t, cell);
+    });
+  }
+
+  /**
+   * @brief A query of up to 64 characters, run with Myers' bit-parallel
+   * algorithm in Hyyrö's formulation
+   *
+   * One bit per query character holds the vertical deltas of a DP column, so
+   * each character of a word costs a few word operations. The match masks of
+   * the query's characters are built once. batch advances four words in lock
+   * step, which gives the processor independent chains to overlap. Longer or
+   * empty queries fall back to compute_distance.
+   */
+  class Prepared {
+  public:
+    Prepared(const EditDistance &metric, std::string_view query) noexcept
+        : m_metric(&metric), m_query(query),
+          m_bit_parallel(!query.empty() && query.size() <= 64) {
+      for (size_t i = 0; m_bit_parallel && i < query.size(); ++i) {
+        m_masks[static_cast<unsigned char>(query[i])] |= std::uint64_t{1} << i;
+      }
     }
-    for (integer_type i = 1; i <= M; ++i) {
-      m_matrix[i][0] = i;
+    std::string_view query() const noexcept { return m_query; }
+    integer_type operator()(std::string_view t) const noexcept {
+      if (!m_bit_parallel) {
+        return m_metric->compute_distance(m_query, t);
+      }
+      Column column(m_query.size());
+      for (char c : t) {
+        advance(column, c);
+      }
+      return column.score;
     }
-    for (integer_type j = 1; j <= N; ++j) {
-      m_matrix[0][j] = j;
+    void batch(std::span<const std::string_view> words,
+               std::span<integer_type> output) const noexcept {
+      constexpr size_t lanes = 4;
+      size_t i = 0;
+      for (; m_bit_parallel && i + lanes <= words.size(); i += lanes) {
+        std::array<Column, lanes> columns;
+        columns.fill(Column(m_query.size()));
+        size_t common = words[i].size();
+        for (size_t lane = 1; lane < lanes; ++lane) {
+          common = std::min(common, words[i + lane].size());
+        }
+        for (size_t j = 0; j < common; ++j) {
+          for (size_t lane = 0; lane < lanes; ++lane) {
+            advance(columns[lane], words[i + lane][j]);
+          }
+        }
+        for (size_t lane = 0; lane < lanes; ++lane) {
+          for (char c : words[i + lane].substr(common)) {
+            advance(columns[lane], c);
+          }
+          output[i + lane] = columns[lane].score;
+        }
+      }
+      for (; i < words.size(); ++i) {
+        output[i] = (*this)(words[i]);
+      }
     }
-    for (integer_type j = 1; j <= N; ++j) {
-      for (integer_type i = 1; i <= M; ++i) {
-        m_matrix[i][j] = std::min(
-            {m_matrix[i][j - 1] + 1 /*Insertion*/, m_matrix[i - 1][j] + 1 /*Deletion*/,
-             m_matrix[i - 1][j - 1] + (s[i - 1] != t[j - 1]) /*Substitution*/});
+
+  private:
+    /**
+     * @brief Vertical deltas of a DP column as two bit vectors, and the score
+     * of its last cell
+     */
+    struct Column {
+      std::uint64_t positive = ~std::uint64_t{0}, negative = 0, last = 0;
+      integer_type score = 0;
+
+      Column() = default;
+      explicit Column(size_t length) noexcept
+          : last(std::uint64_t{1} << (length - 1)), score(length) {}
+    };
+    /**
+     * Moves `column` on by the word character `c`. The bit shifted into the
+     * horizontal deltas is row 0's +1 per column.
+     */
+    void advance(Column &column, char c) const noexcept {
+      const std::uint64_t equal = m_masks[static_cast<unsigned char>(c)];
+      const std::uint64_t vertical = equal | column.negative;
+      const std::uint64_t horizontal =
+          (((equal & column.positive) + column.positive) ^ column.positive) | equal;
+      std::uint64_t up = column.negative | ~(horizontal | column.positive);
+      std::uint64_t down = column.positive & horizontal;
+      column.score += (up & column.last) != 0;
+      column.score -= (down & column.last) != 0;
+      up = (up << 1) | 1;
+      down <<= 1;
+      column.positive = down | ~(vertical | up);
+      column.negative = up & vertical;
+    }
+
+    const EditDistance *m_metric;
+    std::string_view m_query;
+    bool m_bit_parallel;
+    std::array<std::uint64_t, 256> m_masks{};
+  };
+  Prepared prepare(std::string_view query) const noexcept {
+    return Prepared(*this, query);
+  }
+
+private:
+  /**
+   * Deletion and substitution only read the previous row, so they are taken
+   * in one vectorizable pass; insertion is then a running minimum along the
+   * row, \f$d_{i,j} = \min(d_{i,j}, d_{i,j-1} + 1)\f$.
+   */
+  template <typename Cell>
+  static integer_type row_kernel(std::string_view s, std::string_view t,
+                                 Cell) noexcept {
+    const size_t M = s.length(), N = t.length();
+    Cell *previous = helpers::scratch_rows<EditDistance, Cell>(2, N + 1);
+    Cell *current = previous + N + 1;
+    for (size_t j = 0; j <= N; ++j) {
+      previous[j] = static_cast<Cell>(j);
+    }
+    for (size_t i = 1; i <= M; ++i) {
+      const char a = s[i - 1];
+      current[0] = static_cast<Cell>(i);
+      for (size_t j = 1; j <= N; ++j) {
+        current[j] = std::min(
+            static_cast<Cell>(previous[j] + 1) /*Deletion*/,
+            static_cast<Cell>(previous[j - 1] + (a != t[j - 1])) /*Substitution*/);
+      }
+      for (size_t j = 1; j <= N; ++j) {
+        current[j] = std::min(current[j], static_cast<Cell>(current[j - 1] + 1));
+      }
+      std::swap(previous, current);
+    }
+    return previous[N];
+  }
+
+  /**
+   * Anti-diagonal sweep, as LCSubseqDistance::diagonal_kernel.
+   */
+  template <typename Cell>
+  static integer_type diagonal_kernel(std::string_view s, std::string_view t,
+                                      Cell) noexcept {
+    const size_t M = s.length(), N = t.length();
+    Cell *older = helpers::scratch_rows<EditDistance, Cell>(3, M + 1);
+    Cell *old = older + M + 1, *current = old + M + 1;
+    const char *r = helpers::reversed<EditDistance>(t);
+    older[0] = 0;
+    old[0] = old[1] = 1;
+    for (size_t k = 2; k <= M + N; ++k) {
+      const size_t first = k > N ? k - N : 1, last = std::min(M, k - 1);
+      for (size_t i = first; i <= last; ++i) {
+        const bool mismatch = s[i - 1] != r[N - k + i];
+        current[i] = std::min({static_cast<Cell>(old[i - 1] + 1) /*Deletion*/,
+                               static_cast<Cell>(old[i] + 1) /*Insertion*/,
+                               static_cast<Cell>(older[i - 1] + mismatch)});
+      }
+      if (k <= N) {
+        current[0] = static_cast<Cell>(k);
       }
+      if (k <= M) {
+        current[k] = static_cast<Cell>(k);
+      }
+      std::swap(older, old);
+      std::swap(old, current);
     }
-    return m_matrix[M][N];
+    return old[M];
   }
 };
 
@@ -257,39 +642,231 @@ public:
  * Similar to EditDistance, but with transposition.
  */
 class DamerauLevenshteinDistance final : public Distance<DamerauLevenshteinDistance> {
-  mutable std::vector<std::vector<integer_type>> m_matrix;
-
 public:
-  explicit DamerauLevenshteinDistance(size_t initial_size = BK_MATRIX_INITIAL_SIZE)
-      : m_matrix(initial_size, std::vector<integer_type>(initial_size)){};
+  explicit DamerauLevenshteinDistance(size_t initial_size = BK_MATRIX_INITIAL_SIZE) {
+    helpers::scratch_rows<DamerauLevenshteinDistance, std::uint8_t>(3, initial_size);
+  };
+  integer_type lower_bound(const WordSketch &s, const WordSketch &t) const noexcept {
+    const integer_type length_difference =
+        s.length > t.length ? s.length - t.length : t.length - s.length;
+    return std::max(length_difference, missing_classes(s, t));
+  }
+  integer_type upper_bound(const WordSketch &s, const WordSketch &t) const noexcept {
+    return std::max(s.length, t.length);
+  }
   integer_type compute_distance(std::string_view s, std::string_view t) const noexcept {
-    const integer_type M = s.length(), N = t.length();
-    if (M == 0 || N == 0) {
-      return N + M;
+    if (s.empty() || t.empty()) {
+      return s.length() + t.length();
     }
-    if (m_matrix.size() <= M || m_matrix[0].size() <= N) {
-      std::vector<std::vector<integer_type>> a_matrix(M + 1,
-                                                      std::vector<integer_type>(N + 1));
-      m_matrix.swap(a_matrix);
+    const size_t shorter = std::min(s.length(), t.length());
+    return helpers::with_cell_type(std::max(s.length(), t.length()), [&](auto cell) {
+      return shorter < BK_DP_DIAGONAL_MIN_LENGTH ? row_kernel(s, t, cell)
+                                                 : diagonal_kernel(s, t, cell);
+    });
+  }
+
+private:
+  /**
+   * As EditDistance::row_kernel, keeping a third row for the transposition term.
+   */
+  template <typename Cell>
+  static integer_type row_kernel(std::string_view s, std::string_view t,
+                                 Cell) noexcept {
+    const size_t M = s.length(), N = t.length();
+    Cell *before = helpers::scratch_rows<DamerauLevenshteinDistance, Cell>(3, N + 1);
+    Cell *previous = before + N + 1, *current = previous + N + 1;
+    for (size_t j = 0; j <= N; ++j) {
+      previous[j] = static_cast<Cell>(j);
     }
-    for (integer_type i = 1; i <= M; ++i) {
-      m_matrix[i][0] = i;
+    for (size_t i = 1; i <= M; ++i) {
+      const char a = s[i - 1];
+      current[0] = static_cast<Cell>(i);
+      for (size_t j = 1; j <= N; ++j) {
+        current[j] = std::min(
+            static_cast<Cell>(previous[j] + 1) /*Deletion*/,
+            static_cast<Cell>(previous[j - 1] + (a != t[j - 1])) /*Substitution*/);
+      }
+      if (i > 1) {
+        const char b = s[i - 2];
+        for (size_t j = 2; j <= N; ++j) {
+          if (a == t[j - 2] && b == t[j - 1]) {
+            current[j] = std::min(
+                current[j], static_cast<Cell>(before[j - 2] + 1) /*Transposition*/);
+          }
+        }
+      }
+      for (size_t j = 1; j <= N; ++j) {
+        current[j] = std::min(current[j], static_cast<Cell>(current[j - 1] + 1));
+      }
+      std::swap(before, previous);
+      std::swap(previous, current);
     }
-    for (integer_type j = 1; j <= N; ++j) {
-      m_matrix[0][j] = j;
+    return previous[N];
+  }
+
+  /**
+   * As EditDistance::diagonal_kernel; a transposition reaches back four
+   * anti-diagonals, so five are kept.
+   */
+  template <typename Cell>
+  static integer_type diagonal_kernel(std::string_view s, std::string_view t,
+                                      Cell) noexcept {
+    const size_t M = s.length(), N = t.length();
+    Cell *storage = helpers::scratch_rows<DamerauLevenshteinDistance, Cell>(5, M + 1);
+    std::array<Cell *, 5> diagonal; // diagonal[n] holds anti-diagonal k - n
+    for (size_t n = 0; n < diagonal.size(); ++n) {
+      diagonal[n] = storage + n * (M + 1);
+    }
+    const char *r = helpers::reversed<DamerauLevenshteinDistance>(t);
+    diagonal[2][0] = 0;
+    diagonal[1][0] = diagonal[1][1] = 1;
+    for (size_t k = 2; k <= M + N; ++k) {
+      Cell *current = diagonal[0];
+      const Cell *old = diagonal[1], *older = diagonal[2];
+      const size_t first = k > N ? k - N : 1, last = std::min(M, k - 1);
+      for (size_t i = first; i <= last; ++i) {
+        const bool mismatch = s[i - 1] != r[N - k + i];
+        current[i] = std::min({static_cast<Cell>(old[i - 1] + 1) /*Deletion*/,
+                               static_cast<Cell>(old[i] + 1) /*Insertion*/,
+                               static_cast<Cell>(older[i - 1] + mismatch)});
+      }
+      const Cell *oldest = diagonal[4];
+      const size_t stop = std::min(last, k - 2);
+      for (size_t i = std::max<size_t>(first, 2); i <= stop; ++i) {
+        // Bitwise `&` keeps the condition branch-free for the vectorizer
+        const size_t at = N - k + i;
+        const bool swapped = (s[i - 1] == r[at + 1]) & (s[i - 2] == r[at]);
+        const Cell transposed = static_cast<Cell>(oldest[i - 2] + 1) /*Transposition*/;
+        current[i] = std::min(current[i], swapped ? transposed : current[i]);
+      }
+      if (k <= N) {
+        current[0] = static_cast<Cell>(k);
+      }
+      if (k <= M) {
+        current[k] = static_cast<Cell>(k);
+      }
+      std::rotate(diagonal.begin(), diagonal.end() - 1, diagonal.end());
+    }
+    return diagonal[1][M];
+  }
+};
+
+/**
+ * @brief Unit costs for WeightedEditDistance, equivalent to EditDistance
+ */
+struct UnitCost {
+  static constexpr integer_type insertion(unsigned char) noexcept { return 1; }
+  static constexpr integer_type deletion(unsigned char) noexcept { return 1; }
+  static constexpr integer_type substitution(unsigned char a,
+                                             unsigned char b) noexcept {
+    return a != b;
+  }
+};
+
+namespace helpers {
+/**
+ * @brief Substitution cost table of QwertyCost
+ */
+constexpr std::array<std::array<std::uint8_t, 256>, 256> make_qwerty_table() {
+  struct Key {
+    int row = -1, column = -1;
+  };
+  std::array<Key, 256> layout{};
+  constexpr std::string_view rows[] = {"1234567890-=", "qwertyuiop[]", "asdfghjkl;'",
+                                       "zxcvbnm,./"};
+  for (int r = 0; r < 4; ++r) {
+    for (int c = 0; c < static_cast<int>(rows[r].size()); ++c) {
+      const auto key = static_cast<unsigned char>(rows[r][c]);
+      layout[key] = {r, c};
+      if (key >= 'a' && key <= 'z') {
+        layout[key - 'a' + 'A'] = {r, c};
+      }
+    }
+  }
+  std::array<std::array<std::uint8_t, 256>, 256> table{};
+  for (int a = 0; a < 256; ++a) {
+    for (int b = 0; b < 256; ++b) {
+      const Key &x = layout[a], &y = layout[b];
+      const bool same_key = x.row >= 0 && x.row == y.row && x.column == y.column;
+      // Rows are staggered, so a key touches two keys in each neighbouring row
+      const int dr = y.row - x.row, dc = y.column - x.column;
+      const bool adjacent =
+          x.row >= 0 && y.row >= 0 &&
+          ((dr == 0 && (dc == 1 || dc == -1)) || (dr == 1 && (dc == 0 || dc == -1)) ||
+           (dr == -1 && (dc == 0 || dc == 1)));
+      table[a][b] = a == b ? 0 : (same_key || adjacent) ? 1 : 2;
+    }
+  }
+  return table;
+}
+} // namespace helpers
+
+/**
+ * @brief QWERTY keyboard costs for WeightedEditDistance
+ *
+ * Substituting a key with a physically adjacent key (or the same key with a
+ * different case) costs 1, any other substitution costs 2, and insertions and
+ * deletions cost 2. Since every substitution costs at most the sum of two
+ * others, the resulting distance is still a metric.
+ */
+struct QwertyCost {
+  static constexpr auto table = helpers::make_qwerty_table();
+
+  static constexpr integer_type insertion(unsigned char) noexcept { return 2; }
+  static constexpr integer_type deletion(unsigned char) noexcept { return 2; }
+  static constexpr integer_type substitution(unsigned char a,
+                                             unsigned char b) noexcept {
+    return table[a][b];
+  }
+};
+
+/**
+ * @brief Weighted edit distance metric
+ *
+ * Like EditDistance, but the cost of each insertion, deletion and substitution
+ * is given by the compile-time `CostModel` (see UnitCost and QwertyCost), so the
+ * recurrence is fully specialized per model. Costs are integers; for the BK-tree
+ * pruning to stay valid, insertion and deletion of a character must cost the
+ * same, substitution must be symmetric and zero only on equal characters, and
+ * substitution costs must satisfy the triangle inequality.
+ */
+template <typename CostModel>
+class WeightedEditDistance final : public Distance<WeightedEditDistance<CostModel>> {
+  using scratch_type = std::array<std::vector<integer_type>, 2>;
+
+public:
+  explicit WeightedEditDistance(size_t initial_size = BK_ED_MATRIX_INITIAL_SIZE) {
+    auto &[current, previous] =
+        helpers::thread_scratch<WeightedEditDistance, scratch_type>();
+    current.resize(std::max(current.size(), initial_size));
+    previous.resize(std::max(previous.size(), initial_size));
+  };
+  integer_type compute_distance(std::string_view s, std::string_view t) const noexcept {
+    const integer_type M = s.length(), N = t.length();
+    auto &[current, previous] =
+        helpers::thread_scratch<WeightedEditDistance, scratch_type>();
+    if (current.size() <= N || previous.size() <= N) {
+      current.resize(N + 1);
+      previous.resize(N + 1);
     }
+    previous[0] = 0;
     for (integer_type j = 1; j <= N; ++j) {
-      for (integer_type i = 1; i <= M; ++i) {
-        m_matrix[i][j] = std::min(
-            {m_matrix[i][j - 1] + 1 /*Insertion*/, m_matrix[i - 1][j] + 1 /*Deletion*/,
-             m_matrix[i - 1][j - 1] + (s[i - 1] == t[j - 1] ? 0 : 1) /*Substitution*/});
-        if (i > 1 && j > 1 && s[i - 1] == t[j - 2] && s[i - 2] == t[j - 1]) {
-          m_matrix[i][j] =
-              std::min(m_matrix[i][j], m_matrix[i - 2][j - 2] + 1 /*Transposition*/);
-        }
+      previous[j] = previous[j - 1] + CostModel::insertion(t[j - 1]);
+    }
+    for (integer_type i = 1; i <= M; ++i) {
+      const auto a = static_cast<unsigned char>(s[i - 1]);
+      const integer_type deletion = CostModel::deletion(a);
+      current[0] = previous[0] + deletion;
+      for (integer_type j = 1; j <= N; ++j) {
+        const auto b = static_cast<unsigned char>(t[j - 1]);
+        current[j] = std::min(
+            {current[j - 1] + CostModel::insertion(b) /*Insertion*/,
+             previous[j] + deletion /*Deletion*/,
+             previous[j - 1] + CostModel::substitution(a, b) /*Substitution*/});
       }
+      current.swap(previous);
     }
-    return m_matrix[M][N];
+    return previous[N];
   }
 };
 
@@ -303,92 +880,405 @@ std::true_type is_metric_impl(const volatile metrics::Distance<Metric> &);
 
 template <typename Metric>
 using is_metric = decltype(is_metric_impl(std::declval<Metric &>()));
-} // namespace helpers
 
 template <typename Metric>
-class BKTree;
-template <typename Metric>
-class BKTreeNode;
-
-using ResultEntry = std::pair<std::string, int>;
-using ResultList = std::vector<ResultEntry>;
+inline constexpr bool has_bounds =
+    requires(const Metric &metric, const metrics::WordSketch &sketch) {
+  { metric.lower_bound(sketch, sketch) } -> std::convertible_to<integer_type>;
+  { metric.upper_bound(sketch, sketch) } -> std::convertible_to<integer_type>;
+};
 
+/**
+ * @brief What `Metric::prepare` returns; see metrics::Distance
+ */
 template <typename Metric>
-class BKTreeNode {
-  friend class BKTree<Metric>;
-  using metric_type = Metric;
-  using node_type = BKTreeNode<metric_type>;
-
-  BKTreeNode(std::string_view value) : m_word(value) {}
-  bool _insert(std::string_view value, const metric_type &distance);
-  bool _erase(std::string_view value, const metric_type &distance);
-  void _find(ResultList &output, std::string_view value, int limit,
-             const metric_type &metric) const;
-  ResultList _find_wrapper(std::string_view value, int limit,
-                           const metric_type &metric) const;
+using prepared_query =
+    decltype(std::declval<const Metric &>().prepare(std::string_view{}));
 
-  std::map<int, std::unique_ptr<node_type>> m_children;
-  std::string m_word;
+/**
+ * @brief Metrics only defined between words of the same length; specialise it
+ * for custom ones
+ */
+template <typename Metric>
+struct is_fixed_length : std::false_type {};
+template <>
+struct is_fixed_length<metrics::HammingDistance> : std::true_type {};
+template <>
+struct is_fixed_length<metrics::LeeDistance> : std::true_type {};
 
-  friend std::ostream &operator<<(std::ostream &oss, const BKTreeNode &node) {
-    oss << node.m_word;
-    return oss;
+/**
+ * @brief String hash that also accepts `std::string_view`, for lookups without
+ * a temporary key
+ */
+struct WordHash {
+  using is_transparent = void;
+  size_t operator()(std::string_view s) const noexcept {
+    return std::hash<std::string_view>{}(s);
   }
-
-public:
-  std::string_view word() const noexcept { return m_word; }
 };
 
 /**
- * @brief BK-tree template class
+ * @brief Minimal lazily evaluated coroutine generator
+ *
+ * Only supports a single pass with range-based for loops or an input iterator;
+ * the coroutine is resumed each time the iterator is advanced.
  */
-template <typename Metric>
-class BKTree {
-  static_assert(helpers::is_metric<Metric>::value, "Metric must be of type Distance");
+template <typename T>
+class Generator {
+public:
+  struct promise_type {
+    std::optional<T> m_value;
 
-  using metric_type = Metric;
-  using node_type = typename BKTreeNode<metric_type>::node_type;
+    Generator get_return_object() noexcept {
+      return Generator{std::coroutine_handle<promise_type>::from_promise(*this)};
+    }
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    std::suspend_always final_suspend() const noexcept { return {}; }
+    std::suspend_always yield_value(T value) noexcept(
+        std::is_nothrow_move_constructible_v<T>) {
+      m_value.emplace(std::move(value));
+      return {};
+    }
+    void return_void() const noexcept {}
+    void unhandled_exception() { throw; }
+  };
 
-public:
-  /**
-   * @brief BK-tree class iterator
-   */
   class Iterator {
   public:
-    using iterator_category = std::forward_iterator_tag;
+    using iterator_category = std::input_iterator_tag;
     using difference_type = std::ptrdiff_t;
-    using value_type = std::unique_ptr<node_type>;
-    using pointer = std::unique_ptr<node_type> *;
-    using reference = std::unique_ptr<node_type> &;
+    using value_type = T;
+    using reference = T &;
+    using pointer = T *;
 
-  public:
     Iterator() = default;
-    Iterator(pointer ptr) : m_pointer(ptr) {}
-
-    pointer operator->() { return m_pointer; }
+    explicit Iterator(std::coroutine_handle<promise_type> handle) : m_handle(handle) {}
 
-    reference operator*() const { return *m_pointer; }
+    reference operator*() const { return *m_handle.promise().m_value; }
+    pointer operator->() const { return &*m_handle.promise().m_value; }
 
     Iterator &operator++() {
-      if (m_pointer == nullptr) {
-        throw std::out_of_range("No more tree node");
-      }
-      for (auto &[_, child] : (*m_pointer)->m_children) {
-        m_queue.push(&child);
-      }
-      if (m_queue.empty()) {
-        m_pointer = nullptr;
-      } else {
-        m_pointer = m_queue.front();
-        m_queue.pop();
-      }
+      m_handle.resume();
       return *this;
     }
+    void operator++(int) { ++(*this); }
 
-    Iterator operator++(int) {
-      Iterator tmp{*this};
-      ++(*this);
-      return tmp;
+    friend bool operator==(const Iterator &it, std::default_sentinel_t) noexcept {
+      return !it.m_handle || it.m_handle.done();
+    }
+
+  private:
+    std::coroutine_handle<promise_type> m_handle;
+  };
+
+  Generator(Generator &&other) noexcept : m_handle(std::exchange(other.m_handle, {})) {}
+  Generator &operator=(Generator &&other) noexcept {
+    std::swap(m_handle, other.m_handle);
+    return *this;
+  }
+  Generator(const Generator &) = delete;
+  Generator &operator=(const Generator &) = delete;
+  ~Generator() {
+    if (m_handle) {
+      m_handle.destroy();
+    }
+  }
+
+  Iterator begin() {
+    m_handle.resume();
+    return Iterator(m_handle);
+  }
+  std::default_sentinel_t end() const noexcept { return {}; }
+
+private:
+  explicit Generator(std::coroutine_handle<promise_type> handle) : m_handle(handle) {}
+
+  std::coroutine_handle<promise_type> m_handle;
+};
+
+/**
+ * @brief Writes a trivially copyable value in native byte order
+ */
+template <typename T>
+void write_raw(std::ostream &out, const T &value) {
+  out.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+/**
+ * @brief Reads a value written by write_raw; throws on a short read
+ */
+template <typename T>
+T read_raw(std::istream &in) {
+  T value;
+  if (!in.read(reinterpret_cast<char *>(&value), sizeof(T))) {
+    throw std::runtime_error("bk_tree: truncated input");
+  }
+  return value;
+}
+} // namespace helpers
+
+template <typename Metric>
+class BKTree;
+template <typename Metric>
+class BKTreeNode;
+template <typename Metric>
+class CompactBKTree;
+namespace helpers {
+template <typename Metric, typename Callback>
+class TreeJoin;
+} // namespace helpers
+
+using ResultEntry = std::pair<std::string, int>;
+using ResultList = std::vector<ResultEntry>;
+
+/**
+ * @brief Limits on the work of a bounded find
+ */
+struct SearchBudget {
+  size_t max_evaluations = std::numeric_limits<size_t>::max();
+  std::optional<std::chrono::steady_clock::time_point> deadline;
+};
+
+/**
+ * @brief Matches of a bounded find, and whether the search covered every
+ * candidate before the budget ran out
+ */
+struct BoundedResultList {
+  ResultList results;
+  bool complete = true;
+  size_t evaluations = 0;
+};
+
+/**
+ * @brief When a tree rebuilds itself after erases have degraded its layout
+ *
+ * A rebuild is due once the tree's degradation() reaches `degradation` and it
+ * holds at least `min_size` words. A non-positive `degradation` turns automatic
+ * rebuilds off.
+ *
+ * These defaults are ConcurrentBKTree's, whose rebuild runs in the background
+ * without blocking readers. BKTree starts with `degradation` 0 instead: its
+ * relinked subtrees cost no more per query than a fresh build on typical
+ * inputs, and its rebuild would run inside the erase that triggers it. Pass a
+ * policy to set_rebuild_policy to opt in.
+ */
+struct RebuildPolicy {
+  double degradation = BK_REBUILD_DEGRADATION;
+  size_t min_size = BK_REBUILD_MIN_SIZE;
+
+  bool due(double current, size_t size) const noexcept {
+    return degradation > 0 && size >= min_size && current >= degradation;
+  }
+};
+
+/**
+ * @brief Order in which BKTree::words() visits the nodes
+ *
+ * Depth-first is preorder; both orders take a node's children by ascending
+ * distance.
+ */
+enum class Traversal { depth_first, breadth_first };
+
+/**
+ * @brief Result types whose words are allocated from a memory resource
+ */
+namespace pmr {
+using ResultEntry = std::pair<std::pmr::string, int>;
+using ResultList = std::pmr::vector<ResultEntry>;
+} // namespace pmr
+
+template <typename Metric>
+class BKTreeNode {
+  friend class BKTree<Metric>;
+  friend class CompactBKTree<Metric>;
+  template <typename, typename>
+  friend class helpers::TreeJoin;
+  using metric_type = Metric;
+  using node_type = BKTreeNode<metric_type>;
+  using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+  /**
+   * @brief Destroys a node and returns it to the resource it came from
+   */
+  struct Deleter {
+    void operator()(node_type *node) const noexcept {
+      allocator_type allocator = node->m_children.get_allocator();
+      const size_t bytes =
+          _bytes(node->m_word, node->m_borrowed, node->m_pivot_count);
+      std::destroy_at(node);
+      allocator.deallocate_bytes(node, bytes, alignof(node_type));
+    }
+  };
+  using node_pointer = std::unique_ptr<node_type, Deleter>;
+
+  BKTreeNode(std::string_view value, bool borrowed, std::uint16_t pivot_count,
+             allocator_type allocator)
+      : m_children(allocator), m_word(value), m_sketch(value), m_borrowed(borrowed),
+        m_pivot_count(pivot_count) {}
+  static size_t _bytes(std::string_view value, bool borrowed,
+                       size_t pivot_count) noexcept {
+    return sizeof(node_type) + pivot_count * sizeof(int) +
+           (borrowed ? 0 : value.size());
+  }
+  /**
+   * @brief Allocates a node; its distances to the tree's pivots and an owned
+   * word are copied right behind the node
+   *
+   * A borrowed word is viewed in place and must outlive the node.
+   */
+  static node_pointer _make(std::string_view value, allocator_type allocator,
+                            bool borrowed = false, std::span<const int> pivots = {}) {
+    const size_t bytes = _bytes(value, borrowed, pivots.size());
+    void *memory = allocator.allocate_bytes(bytes, alignof(node_type));
+    char *tail = static_cast<char *>(memory) + sizeof(node_type);
+    std::copy(pivots.begin(), pivots.end(), reinterpret_cast<int *>(tail));
+    if (!borrowed) {
+      char *word = tail + pivots.size_bytes();
+      std::copy(value.begin(), value.end(), word);
+      value = std::string_view(word, value.size());
+    }
+    try {
+      return node_pointer(::new (memory) node_type(
+          value, borrowed, static_cast<std::uint16_t>(pivots.size()), allocator));
+    } catch (...) {
+      allocator.deallocate_bytes(memory, bytes, alignof(node_type));
+      throw;
+    }
+  }
+  std::span<const int> _pivots() const noexcept {
+    return {reinterpret_cast<const int *>(this + 1), m_pivot_count};
+  }
+  bool _insert(std::string_view value, const metric_type &distance,
+               bool borrowed = false, std::span<const int> pivots = {});
+  bool _erase(std::string_view value, const metric_type &distance,
+              size_t &relinked);
+  template <typename Predicate>
+  void _sweep(Predicate &victim, const metric_type &distance, size_t &erased,
+              size_t &relinked, std::vector<node_pointer> &orphans);
+  template <typename Predicate>
+  static void _detach(node_pointer node, Predicate &victim, size_t &erased,
+                      std::vector<node_pointer> &orphans);
+  size_t _merge(node_pointer incoming, const metric_type &distance);
+  const node_type *_locate(std::string_view value, const metric_type &distance) const;
+
+  /**
+   * @brief Everything a search works out about its query once
+   *
+   * `prepared` evaluates the metric against node words, `pivots` are the
+   * query's distances to the tree's pivots, and `skipped` counts the nodes
+   * a search passed over thanks to them.
+   */
+  struct Query {
+    helpers::prepared_query<Metric> prepared;
+    metrics::WordSketch sketch;
+    std::span<const int> pivots;
+    mutable size_t skipped = 0;
+  };
+  std::pair<int, int> _bounds(const Query &query, int limit, const metric_type &metric,
+                              bool pivots = true) const;
+  auto _candidates(int lower, int upper, int limit) const;
+  bool _pruned_by_pivots(const Query &query, int limit,
+                         const metric_type &metric) const;
+  bool _prunable(const Query &query, int limit, const metric_type &metric) const;
+  template <typename OutputList>
+  void _find(OutputList &output, const Query &query, int limit,
+             const metric_type &metric) const;
+  void _serialize(std::ostream &out) const;
+  static node_pointer _deserialize(std::istream &in, allocator_type allocator,
+                                   std::string &buffer, size_t &count);
+
+  /**
+   * @brief A query of a batched find and the list its matches are appended to
+   */
+  struct BatchQuery {
+    Query query;
+    ResultList *output;
+  };
+  // Pairs of (query index, distance to the node that admitted the query)
+  using batch_stack = std::vector<std::pair<size_t, int>>;
+  void _find_batch(const std::vector<BatchQuery> &queries, batch_stack &active,
+                   size_t begin, int limit, const metric_type &metric) const;
+
+  std::pmr::map<int, node_pointer> m_children;
+  std::string_view m_word;
+  metrics::WordSketch m_sketch;
+  bool m_borrowed;
+  std::uint16_t m_pivot_count;
+
+  friend std::ostream &operator<<(std::ostream &oss, const BKTreeNode &node) {
+    oss << node.m_word;
+    return oss;
+  }
+
+public:
+  std::string_view word() const noexcept { return m_word; }
+};
+
+/**
+ * @brief BK-tree template class
+ *
+ * Nodes, their child maps and their words are allocated from the tree's
+ * `std::pmr::memory_resource` (the default resource unless one is given). With
+ * a `std::pmr::monotonic_buffer_resource`, abandon() followed by releasing the
+ * resource drops a whole tree without visiting its nodes. Words added through
+ * insert_views are not copied at all; the tree keeps their storage alive.
+ */
+template <typename Metric>
+class BKTree {
+  static_assert(helpers::is_metric<Metric>::value, "Metric must be of type Distance");
+  friend class CompactBKTree<Metric>;
+  template <typename, typename>
+  friend class helpers::TreeJoin;
+
+  using metric_type = Metric;
+  using node_type = typename BKTreeNode<metric_type>::node_type;
+  using node_pointer = typename BKTreeNode<metric_type>::node_pointer;
+
+public:
+  using allocator_type = typename BKTreeNode<metric_type>::allocator_type;
+
+  /**
+   * @brief BK-tree class iterator
+   *
+   * Visits the nodes breadth-first. words() is the read-only alternative that
+   * does not allocate per step.
+   */
+  class Iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using difference_type = std::ptrdiff_t;
+    using value_type = node_pointer;
+    using pointer = node_pointer *;
+    using reference = node_pointer &;
+
+  public:
+    Iterator() = default;
+    Iterator(pointer ptr) : m_pointer(ptr) {}
+
+    pointer operator->() { return m_pointer; }
+
+    reference operator*() const { return *m_pointer; }
+
+    Iterator &operator++() {
+      if (m_pointer == nullptr) {
+        throw std::out_of_range("No more tree node");
+      }
+      for (auto &[_, child] : (*m_pointer)->m_children) {
+        m_queue.push(&child);
+      }
+      if (m_queue.empty()) {
+        m_pointer = nullptr;
+      } else {
+        m_pointer = m_queue.front();
+        m_queue.pop();
+      }
+      return *this;
+    }
+
+    Iterator operator++(int) {
+      Iterator tmp{*this};
+      ++(*this);
+      return tmp;
     }
 
     friend bool operator==(const Iterator &a, const Iterator &b) {
@@ -404,90 +1294,500 @@ public:
     std::queue<pointer> m_queue;
   };
 
+  /**
+   * @brief Read-only iterator over the words of a tree, in `Order`
+   *
+   * The nodes still to be visited are kept in vectors that grow to the largest
+   * frontier of the traversal and are reused from then on, so stepping does
+   * not allocate once they have. Copying the iterator copies the frontier;
+   * prefer pre-increment. The tree must not be modified while it is iterated.
+   */
+  template <Traversal Order>
+  class WordIterator {
+  public:
+    using iterator_concept = std::forward_iterator_tag;
+    using iterator_category = std::input_iterator_tag;
+    using difference_type = std::ptrdiff_t;
+    using value_type = std::string_view;
+    using reference = std::string_view;
+
+  public:
+    WordIterator() = default;
+    explicit WordIterator(const node_type *root) {
+      if (root != nullptr) {
+        m_frontier.push_back(root);
+      }
+    }
+
+    reference operator*() const noexcept { return _node()->m_word; }
+
+    WordIterator &operator++() {
+      const node_type *node = _node();
+      if constexpr (Order == Traversal::depth_first) {
+        // Pushed in reverse, so that the nearest child is visited first
+        m_frontier.pop_back();
+        for (auto it = node->m_children.rbegin(); it != node->m_children.rend();
+             ++it) {
+          m_frontier.push_back(it->second.get());
+        }
+      } else {
+        for (auto const &[_, child] : node->m_children) {
+          m_next.push_back(child.get());
+        }
+        if (++m_position == m_frontier.size()) {
+          std::swap(m_frontier, m_next);
+          m_next.clear();
+          m_position = 0;
+        }
+      }
+      return *this;
+    }
+
+    WordIterator operator++(int) {
+      WordIterator tmp{*this};
+      ++(*this);
+      return tmp;
+    }
+
+    friend bool operator==(const WordIterator &a, const WordIterator &b) noexcept {
+      return a._node() == b._node();
+    }
+
+    friend bool operator==(const WordIterator &it, std::default_sentinel_t) noexcept {
+      return it.m_frontier.empty();
+    }
+
+  private:
+    const node_type *_node() const noexcept {
+      if (m_frontier.empty()) {
+        return nullptr;
+      }
+      if constexpr (Order == Traversal::depth_first) {
+        return m_frontier.back();
+      } else {
+        return m_frontier[m_position];
+      }
+    }
+
+    // The stack of a depth-first traversal; the current level of a
+    // breadth-first one, whose next level is gathered in m_next
+    std::vector<const node_type *> m_frontier;
+    std::vector<const node_type *> m_next;
+    size_t m_position = 0;
+  };
+
+  /**
+   * @brief `std::ranges` view over the words of a tree; see words()
+   */
+  template <Traversal Order>
+  class WordView : public std::ranges::view_interface<WordView<Order>> {
+  public:
+    WordView() = default;
+    explicit WordView(const node_type *root) noexcept : m_root(root) {}
+
+    WordIterator<Order> begin() const { return WordIterator<Order>(m_root); }
+    std::default_sentinel_t end() const noexcept { return {}; }
+
+  private:
+    const node_type *m_root = nullptr;
+  };
+
 public:
-  BKTree(const metric_type &distance = Metric())
-      : m_root(nullptr), m_metric(distance), m_tree_size(BK_TREE_INITIAL_SIZE) {}
+  BKTree(const metric_type &distance = Metric(), allocator_type allocator = {})
+      : m_root(nullptr), m_metric(distance), m_tree_size(BK_TREE_INITIAL_SIZE),
+        m_resource(allocator.resource()) {}
+
+  explicit BKTree(allocator_type allocator) : BKTree(Metric(), allocator) {}
 
-  BKTree(std::initializer_list<std::string_view> list)
-      : m_root(nullptr), m_metric(Metric()), m_tree_size(BK_TREE_INITIAL_SIZE) {
+  BKTree(std::initializer_list<std::string_view> list, allocator_type allocator = {})
+      : BKTree(Metric(), allocator) {
     for (auto &str : list) {
       insert(str);
     }
   }
 
-  BKTree(const BKTree &other) : BKTree(other.m_metric) {
-    if (other.m_root == nullptr) {
-      return;
+  BKTree(const BKTree &other) : BKTree(other, allocator_type{}) {}
+
+  BKTree(const BKTree &other, allocator_type allocator)
+      : BKTree(other.m_metric, allocator) {
+    m_policy = other.m_policy;
+    m_pivots = other.m_pivots;
+    std::queue<node_pointer const *> bq;
+    if (other.m_root != nullptr) {
+      bq.push(&(other.m_root));
     }
-    std::queue<std::unique_ptr<node_type> const *> bq;
-    bq.push(&(other.m_root));
     while (!bq.empty()) {
       auto *nptr = bq.front();
       bq.pop();
-      this->insert((*nptr)->m_word);
+      _insert((*nptr)->m_word, false, (*nptr)->_pivots());
       for (auto &[_, child_node] : (*nptr)->m_children) {
         bq.push(&child_node);
       }
     }
+    // The breadth-first copy has the same layout
+    m_relinked = other.m_relinked;
+    set_membership_index(other.has_membership_index());
   }
 
   BKTree(BKTree &&other) noexcept
-      : m_root(std::exchange(other.m_root, nullptr)), m_tree_size(other.m_tree_size) {}
+      : m_storage(std::move(other.m_storage)),
+        m_root(std::exchange(other.m_root, nullptr)), m_metric(other.m_metric),
+        m_tree_size(other.m_tree_size), m_resource(other.m_resource),
+        m_relinked(other.m_relinked), m_policy(other.m_policy),
+        m_index(std::move(other.m_index)), m_pivots(std::move(other.m_pivots)),
+        m_pivot_skips(other.m_pivot_skips.load(std::memory_order_relaxed)) {}
 
   BKTree &operator=(const BKTree &other) {
     if (this == &other) {
       return *this;
     }
-    BKTree temp(other);
+    BKTree temp(other, get_allocator());
     std::swap(m_root, temp.m_root);
     std::swap(m_tree_size, temp.m_tree_size);
+    std::swap(m_storage, temp.m_storage);
+    std::swap(m_relinked, temp.m_relinked);
+    std::swap(m_index, temp.m_index);
+    std::swap(m_pivots, temp.m_pivots);
+    m_policy = other.m_policy;
     return *this;
   }
 
   BKTree &operator=(BKTree &&other) noexcept {
+    std::swap(m_storage, other.m_storage);
     std::swap(m_root, other.m_root);
     std::swap(m_tree_size, other.m_tree_size);
+    std::swap(m_resource, other.m_resource);
+    std::swap(m_relinked, other.m_relinked);
+    std::swap(m_policy, other.m_policy);
+    std::swap(m_index, other.m_index);
+    std::swap(m_pivots, other.m_pivots);
+    m_pivot_skips.store(other.m_pivot_skips.exchange(
+                            m_pivot_skips.load(std::memory_order_relaxed),
+                            std::memory_order_relaxed),
+                        std::memory_order_relaxed);
     return *this;
   }
 
   ~BKTree() = default;
 
   bool insert(std::string_view value);
+  size_t insert_views(std::span<const std::string_view> values,
+                      std::shared_ptr<const void> storage, size_t thread_count = 1);
   bool erase(std::string_view value);
+  template <typename Predicate>
+  requires std::predicate<Predicate &, std::string_view>
+  size_t erase_if(Predicate pred);
+
+  /**
+   * @brief Erases one occurrence of every word in `values`, as many times as it
+   * is listed, in a single erase_if pass; returns the number erased
+   */
+  template <typename Range>
+  requires std::ranges::input_range<Range> &&
+      std::convertible_to<std::ranges::range_reference_t<Range>, std::string_view>
+  size_t erase_many(Range &&values) {
+    std::unordered_map<std::string, size_t, helpers::WordHash, std::equal_to<>> pending;
+    for (auto &&value : values) {
+      ++pending[std::string(std::string_view(value))];
+    }
+    return erase_if([&pending](std::string_view word) {
+      auto it = pending.find(word);
+      if (it == pending.end() || it->second == 0) {
+        return false;
+      }
+      --it->second;
+      return true;
+    });
+  }
+  size_t merge(BKTree &&other);
+  [[nodiscard]] bool contains(std::string_view value) const;
   size_t size() const noexcept { return m_tree_size; }
   bool empty() const noexcept { return m_tree_size == 0; }
   [[nodiscard]] ResultList find(std::string_view value, int limit) const;
+  void find(std::string_view value, int limit, pmr::ResultList &output) const;
+
+  /**
+   * @brief Nodes relinked by erase since the tree was built, per word
+   *
+   * Erasing a node re-inserts its whole subtree below the node's parent, and
+   * repeated erases leave the tree deeper than a fresh build of the same words.
+   * Kept as a counter, so it is free to read.
+   */
+  double degradation() const noexcept {
+    return m_tree_size == 0 ? 0.0 : static_cast<double>(m_relinked) / m_tree_size;
+  }
+  const RebuildPolicy &rebuild_policy() const noexcept { return m_policy; }
+  void set_rebuild_policy(const RebuildPolicy &policy) noexcept { m_policy = policy; }
+  [[nodiscard]] BKTree rebuilt() const;
+
+  /**
+   * @brief Replaces the tree with rebuilt()
+   *
+   * An update like any other: no find or other call may run on the tree
+   * meanwhile. To rebuild without blocking readers, use ConcurrentBKTree, or
+   * build with rebuilt() aside and swap it in under the caller's own lock.
+   */
+  void rebuild() { *this = rebuilt(); }
+
+  /**
+   * @brief Turns the hash index from word to multiplicity on or off
+   *
+   * With the index, contains is a single lookup, insert rejects a word already
+   * present without walking the tree, and erase returns at once for an absent
+   * word. The tree then holds each word at most once, like a set; duplicates
+   * present when the index is turned on stay and are counted. The index costs
+   * a copy of every word, allocated from the tree's memory resource.
+   */
+  void set_membership_index(bool enabled);
+  bool has_membership_index() const noexcept { return m_index != nullptr; }
+
+  /**
+   * @brief Makes `pivots` the tree's pivots, LAESA-style
+   *
+   * Every node then stores its distances to the pivots, and every query first
+   * measures its own. Through the triangle inequality, which the tree's own
+   * pruning relies on as well, these bound the distance from the query to each
+   * node. Once the bounds rule a node out as a match, find passes over it
+   * without evaluating the metric and searches the children the bounds leave
+   * (see BKTreeNode::_find). Each pivot costs one evaluation per insert and
+   * per query, and an int per node. Existing nodes are updated in place; an
+   * empty list removes the pivots. Pivots are not serialized.
+   */
+  void set_pivots(std::vector<std::string> pivots);
+  void select_pivots(size_t count = BK_PIVOT_COUNT);
+  const std::vector<std::string> &pivots() const noexcept { return m_pivots; }
+  /**
+   * @brief Nodes that finds have passed over without evaluating the metric
+   * thanks to the pivots
+   *
+   * Some of them would not have been visited at all without the pivots; each
+   * query also spends pivot_count() evaluations on its own pivot distances.
+   */
+  size_t pivot_skips() const noexcept {
+    return m_pivot_skips.load(std::memory_order_relaxed);
+  }
+  size_t pivot_count() const noexcept { return m_pivots.size(); }
+
+  /**
+   * @brief Runs find for every query in `values` in one traversal
+   *
+   * The queries descend the tree together: each node is visited once per batch
+   * and compared against every query still active below its parent, so the
+   * upper levels are loaded once rather than once per query. Entry `i` of the
+   * result equals `find(values[i], limit)`, in the same order.
+   */
+  template <typename Range>
+  requires std::ranges::input_range<Range> &&
+      std::convertible_to<std::ranges::range_reference_t<Range>, std::string_view>
+  [[nodiscard]] std::vector<ResultList> find_batch(Range &&values, int limit) const {
+    std::vector<std::string_view> views;
+    // Elements yielded by value, or by a single-pass range that may reuse its
+    // buffer, do not outlive their iteration and are copied first
+    std::vector<std::string> owned;
+    if constexpr (std::ranges::forward_range<Range> &&
+                  std::is_lvalue_reference_v<std::ranges::range_reference_t<Range>>) {
+      for (auto &&value : values) {
+        views.push_back(value);
+      }
+    } else {
+      for (auto &&value : values) {
+        owned.emplace_back(std::string_view(value));
+      }
+      views.assign(owned.begin(), owned.end());
+    }
+    std::vector<ResultList> outputs(views.size());
+    // One row of pivot distances per query
+    std::vector<int> pivots(views.size() * m_pivots.size());
+    std::vector<typename node_type::BatchQuery> queries;
+    typename node_type::batch_stack active;
+    for (size_t i = 0; i < views.size(); ++i) {
+      std::span<int> row(pivots.data() + i * m_pivots.size(), m_pivots.size());
+      queries.push_back({_query(views[i], row), &outputs[i]});
+      active.emplace_back(i, 0);
+    }
+    if (m_root != nullptr && !active.empty()) {
+      m_root->_find_batch(queries, active, 0, limit, m_metric);
+    }
+    for (auto const &batch : queries) {
+      _count_skips(batch.query);
+    }
+    return outputs;
+  }
+  [[nodiscard]] helpers::Generator<ResultEntry> find_lazy(std::string_view value,
+                                                          int limit) const;
+  [[nodiscard]] BoundedResultList find_bounded(std::string_view value, int limit,
+                                               const SearchBudget &budget) const;
+
+  allocator_type get_allocator() const noexcept { return allocator_type(m_resource); }
+
+  void serialize(std::ostream &out) const;
+  static BKTree deserialize(std::istream &in, const metric_type &distance = Metric(),
+                            allocator_type allocator = {});
+
+  /**
+   * @brief Forgets every node without destroying or deallocating it
+   *
+   * Only meant for trees whose memory resource frees its storage wholesale,
+   * such as `std::pmr::monotonic_buffer_resource`; with the default resource
+   * the nodes are leaked.
+   */
+  void abandon() noexcept {
+    static_cast<void>(m_root.release());
+    m_tree_size = 0;
+    if (m_index != nullptr) {
+      m_index->clear();
+    }
+  }
 
   Iterator begin() { return Iterator(&m_root); }
   Iterator end() { return Iterator(); }
 
+  /**
+   * @brief Every word of the tree, as a view of `std::string_view`
+   *
+   * The view stays valid as long as the tree is not modified, and each of its
+   * iterators traverses the tree anew.
+   */
+  template <Traversal Order = Traversal::depth_first>
+  [[nodiscard]] WordView<Order> words() const noexcept {
+    return WordView<Order>(m_root.get());
+  }
+
+  template <typename Function>
+  requires std::invocable<Function &, std::string_view>
+  void parallel_for_each(Function fn, size_t thread_count =
+                                          std::thread::hardware_concurrency()) const;
+
 private:
-  std::unique_ptr<node_type> m_root;
+  static constexpr std::string_view serial_magic = "BKT1";
+
+  using membership_index = std::pmr::unordered_map<std::pmr::string, size_t,
+                                                   helpers::WordHash, std::equal_to<>>;
+  void _index_add(std::string_view value);
+  void _index_remove(std::string_view value);
+  void _reindex();
+
+  // Runs work(worker) on the calling thread and thread_count - 1 others
+  template <typename Work>
+  static void _in_parallel(size_t thread_count, Work &&work) {
+    std::vector<std::future<void>> pending;
+    for (size_t worker = 1; worker < thread_count; ++worker) {
+      pending.push_back(std::async(std::launch::async, work, worker));
+    }
+    work(0);
+    for (auto &future : pending) {
+      future.get();
+    }
+  }
+
+  using query_type = typename node_type::Query;
+  bool _insert(std::string_view value, bool borrowed, std::span<const int> pivots);
+  std::span<const int> _pivot_distances(std::string_view value,
+                                        std::vector<int> &scratch) const;
+  /**
+   * @brief Prepares `value` for a search; its pivot distances go to `pivots`,
+   * which holds pivot_count() entries
+   */
+  query_type _query(std::string_view value, std::span<int> pivots) const {
+    query_type query{m_metric.prepare(value), metrics::WordSketch(value), pivots};
+    for (size_t i = 0; i < m_pivots.size(); ++i) {
+      pivots[i] = query.prepared(m_pivots[i]);
+    }
+    return query;
+  }
+  void _count_skips(const query_type &query) const noexcept {
+    if (query.skipped > 0) {
+      m_pivot_skips.fetch_add(query.skipped, std::memory_order_relaxed);
+    }
+  }
+
+  // Keeps the words viewed by borrowed nodes alive; declared before m_root so
+  // that it outlives the nodes
+  std::vector<std::shared_ptr<const void>> m_storage;
+  node_pointer m_root;
   const metric_type m_metric;
   size_t m_tree_size;
+  std::pmr::memory_resource *m_resource;
+  size_t m_relinked = 0;
+  // Automatic rebuilds are opt-in here; see RebuildPolicy
+  RebuildPolicy m_policy{.degradation = 0};
+  std::unique_ptr<membership_index> m_index;
+  std::vector<std::string> m_pivots;
+  std::vector<int> m_pivot_scratch;
+  mutable std::atomic<size_t> m_pivot_skips = 0;
 };
 
 template <typename Metric>
 bool BKTreeNode<Metric>::_insert(std::string_view value,
-                                 const metric_type &distance_metric) {
+                                 const metric_type &distance_metric, bool borrowed,
+                                 std::span<const int> pivots) {
   const int distance_between = distance_metric(value, m_word);
   bool inserted = false;
   if (distance_between >= 0) {
     auto it = m_children.find(distance_between);
     if (it == m_children.end()) {
-      m_children.emplace(std::make_pair(
-          distance_between, std::unique_ptr<node_type>(new node_type(value))));
+      m_children.emplace(distance_between, _make(value, m_children.get_allocator(),
+                                                 borrowed, pivots));
       inserted = true;
     } else {
-      inserted = it->second->_insert(value, distance_metric);
+      inserted = it->second->_insert(value, distance_metric, borrowed, pivots);
     }
   }
   return inserted;
 }
 
+/**
+ * @brief Moves every node of `incoming` into this subtree without copying it
+ *
+ * A pending pair (target, node) means the whole subtree of `node` belongs below
+ * `target`. When both hold the same word, the children of `node` keep their
+ * distances, so each one is grafted as a whole onto a free key of `target`, or
+ * paired with the child already there. Otherwise the children are paired with
+ * `target` themselves, and `node` alone is relinked down the insertion path.
+ *
+ * @return the number of nodes dropped for a negative distance
+ */
 template <typename Metric>
-bool BKTreeNode<Metric>::_erase(std::string_view value,
-                                const metric_type &distance_metric) {
+size_t BKTreeNode<Metric>::_merge(node_pointer incoming,
+                                  const metric_type &distance_metric) {
+  size_t dropped = 0;
+  std::vector<std::pair<node_type *, node_pointer>> pending;
+  pending.emplace_back(this, std::move(incoming));
+  while (!pending.empty()) {
+    auto [target, node] = std::move(pending.back());
+    pending.pop_back();
+    for (;;) {
+      const bool same_word = node->m_word == target->m_word;
+      for (auto &[key, child] : node->m_children) {
+        if (!same_word) {
+          pending.emplace_back(target, std::move(child));
+          continue;
+        }
+        auto [it, grafted] = target->m_children.try_emplace(key, std::move(child));
+        if (!grafted) {
+          pending.emplace_back(it->second.get(), std::move(child));
+        }
+      }
+      node->m_children.clear();
+      const int distance_between = distance_metric(node->m_word, target->m_word);
+      if (distance_between < 0) {
+        ++dropped;
+        break;
+      }
+      auto [it, placed] = target->m_children.try_emplace(distance_between, nullptr);
+      if (placed) {
+        it->second = std::move(node);
+        break;
+      }
+      target = it->second.get();
+    }
+  }
+  return dropped;
+}
+
+template <typename Metric>
+bool BKTreeNode<Metric>::_erase(std::string_view value,
+                                const metric_type &distance_metric, size_t &relinked) {
   bool erased = false;
   const int distance_between = distance_metric(value, m_word);
   auto it = m_children.find(distance_between);
@@ -495,7 +1795,7 @@ bool BKTreeNode<Metric>::_erase(std::string_view value,
     if (it->second->m_word == value) {
       auto node = std::move(it->second);
       m_children.erase(it);
-      std::queue<std::unique_ptr<node_type> const *> bq;
+      std::queue<node_pointer const *> bq;
       for (auto const &[_, child_node] : node->m_children) {
         bq.push(&child_node);
       }
@@ -505,54 +1805,417 @@ bool BKTreeNode<Metric>::_erase(std::string_view value,
         for (auto const &[_, child_node] : (*node)->m_children) {
           bq.push(&child_node);
         }
-        _insert((*node)->m_word, distance_metric);
+        _insert((*node)->m_word, distance_metric, (*node)->m_borrowed,
+                (*node)->_pivots());
+        ++relinked;
       }
       erased = true;
     } else {
-      erased = it->second->_erase(value, distance_metric);
+      erased = it->second->_erase(value, distance_metric, relinked);
     }
-  } else {
-    for (auto const &[_, child] : m_children) {
-      if (child->_erase(value, distance_metric)) {
-        return true;
+  }
+  // Every word lies on the path its own distances lead to (see _locate), so no
+  // other child can hold it
+  return erased;
+}
+
+/**
+ * @brief Erases the nodes below this one that `victim` selects
+ *
+ * Surviving children are swept first, and the survivors below each of their
+ * erased descendants are relinked under them. The survivors below erased
+ * children of this node are left in `orphans` for the caller, which relinks
+ * them once this node's own place is settled. Each node is tested once and
+ * relinked at most once, keeping its allocation.
+ */
+template <typename Metric>
+template <typename Predicate>
+void BKTreeNode<Metric>::_sweep(Predicate &victim, const metric_type &distance_metric,
+                                size_t &erased, size_t &relinked,
+                                std::vector<node_pointer> &orphans) {
+  std::vector<node_pointer> below;
+  for (auto it = m_children.begin(); it != m_children.end();) {
+    node_type *child = it->second.get();
+    if (victim(child->m_word)) {
+      ++erased;
+      for (auto &[_, grandchild] : child->m_children) {
+        _detach(std::move(grandchild), victim, erased, orphans);
       }
+      it = m_children.erase(it);
+      continue;
+    }
+    child->_sweep(victim, distance_metric, erased, relinked, below);
+    for (auto &orphan : below) {
+      static_cast<void>(child->_merge(std::move(orphan), distance_metric));
     }
+    relinked += below.size();
+    below.clear();
+    ++it;
   }
-  return erased;
 }
 
+/**
+ * @brief Takes apart the subtree at `node`: the nodes `victim` spares go to
+ * `orphans` without their children, the others are destroyed
+ */
+template <typename Metric>
+template <typename Predicate>
+void BKTreeNode<Metric>::_detach(node_pointer node, Predicate &victim, size_t &erased,
+                                 std::vector<node_pointer> &orphans) {
+  std::vector<node_pointer> stack;
+  stack.push_back(std::move(node));
+  while (!stack.empty()) {
+    node_pointer top = std::move(stack.back());
+    stack.pop_back();
+    for (auto &[_, child] : top->m_children) {
+      stack.push_back(std::move(child));
+    }
+    top->m_children.clear();
+    if (victim(top->m_word)) {
+      ++erased;
+    } else {
+      orphans.push_back(std::move(top));
+    }
+  }
+}
+
+/**
+ * @brief Follows the insertion path of `value` down to the node holding it
+ *
+ * The path is the one insert took, so an absent word costs one distance per
+ * level and never branches.
+ *
+ * @return the node nearest to this one holding `value`, or `nullptr`
+ */
+template <typename Metric>
+const BKTreeNode<Metric> *
+BKTreeNode<Metric>::_locate(std::string_view value,
+                            const metric_type &distance_metric) const {
+  const node_type *node = this;
+  while (node != nullptr && node->m_word != value) {
+    auto it = node->m_children.find(distance_metric(value, node->m_word));
+    node = it == node->m_children.end() ? nullptr : it->second.get();
+  }
+  return node;
+}
+
+/**
+ * @brief Bounds on the distance from the query to this node
+ *
+ * From the metric's own bounds, and the triangle inequality through each pivot
+ * that neither distance is negative for (a word the metric rejects). The upper
+ * bound is only worked out when the lower one exceeds `limit`.
+ */
+template <typename Metric>
+std::pair<int, int> BKTreeNode<Metric>::_bounds(const Query &query, int limit,
+                                                const metric_type &metric,
+                                                bool pivots) const {
+  int lower = 0, upper = std::numeric_limits<int>::max();
+  const int *own = _pivots().data();
+  for (size_t i = 0; pivots && i < query.pivots.size(); ++i) {
+    const int q = query.pivots[i], n = own[i];
+    if (q >= 0 && n >= 0) {
+      lower = std::max(lower, std::abs(q - n));
+      upper = std::min(upper, q + n);
+    }
+  }
+  if constexpr (helpers::has_bounds<Metric>) {
+    lower = std::max<int>(lower, metric.lower_bound(query.sketch, m_sketch));
+    if (lower > limit) {
+      upper = std::min<int>(upper, metric.upper_bound(query.sketch, m_sketch));
+    }
+  }
+  return {lower, upper};
+}
+
+/**
+ * @brief Children that may hold a match when this node cannot be one
+ *
+ * Keys of children within `limit` of the bounds `[lower, upper]` on the
+ * query's distance to this node.
+ */
+template <typename Metric>
+auto BKTreeNode<Metric>::_candidates(int lower, int upper, int limit) const {
+  auto first = m_children.lower_bound(lower - limit);
+  auto last = first;
+  while (last != m_children.end() && last->first - limit <= upper) {
+    ++last;
+  }
+  return std::ranges::subrange(first, last);
+}
+
+/**
+ * @brief Whether a node the bounds ruled out with its subtree owes it to the pivots
+ *
+ * True when the metric's own bounds would have admitted the node or one of its
+ * children, so that the full distance would have been computed without pivots.
+ */
+template <typename Metric>
+bool BKTreeNode<Metric>::_pruned_by_pivots(const Query &query, int limit,
+                                           const metric_type &metric) const {
+  if (query.pivots.empty()) {
+    return false;
+  }
+  const auto [lower, upper] = _bounds(query, limit, metric, false);
+  return lower <= limit || !_candidates(lower, upper, limit).empty();
+}
+
+template <typename Metric>
+bool BKTreeNode<Metric>::_prunable(const Query &query, int limit,
+                                   const metric_type &metric) const {
+  // The node cannot be reported; if the bounds also rule out every child,
+  // the full distance would not prune anything further.
+  const auto [lower, upper] = _bounds(query, limit, metric);
+  if (lower <= limit || !_candidates(lower, upper, limit).empty()) {
+    return false;
+  }
+  if (_pruned_by_pivots(query, limit, metric)) {
+    ++query.skipped;
+  }
+  return true;
+}
+
+/**
+ * @brief Appends the matches in this subtree to `output`
+ *
+ * Once the bounds rule this node out, the full distance is only computed when
+ * the tree has no pivots: with them, the node is passed over, and the children
+ * its bounds leave are searched directly.
+ */
 template <typename Metric>
-void BKTreeNode<Metric>::_find(ResultList &output, std::string_view value,
-                               int limit, const metric_type &metric) const {
-  const int distance = metric(value, m_word);
+template <typename OutputList>
+void BKTreeNode<Metric>::_find(OutputList &output, const Query &query, int limit,
+                               const metric_type &metric) const {
+  const auto [lower, upper] = _bounds(query, limit, metric);
+  if (lower > limit) {
+    auto children = _candidates(lower, upper, limit);
+    if (children.empty()) {
+      if (_pruned_by_pivots(query, limit, metric)) {
+        ++query.skipped;
+      }
+      return;
+    }
+    if (!query.pivots.empty()) {
+      ++query.skipped;
+      for (auto const &[_, node] : children) {
+        node->_find(output, query, limit, metric);
+      }
+      return;
+    }
+  }
+  const int distance = query.prepared(m_word);
   if (distance <= limit) {
-    output.push_back({m_word, distance});
+    output.emplace_back(std::string_view(m_word), distance);
   }
   for (auto const &[dist, node] : m_children) {
     if (std::abs(dist - distance) <= limit) {
-      node->_find(output, value, limit, metric);
+      node->_find(output, query, limit, metric);
     }
   }
 }
 
+/**
+ * @brief Visits this node for the queries in `active[begin, active.size())`
+ *
+ * The distances of the queries that reach this node are pushed above them, and
+ * each child's queries above those; everything pushed is popped on return.
+ */
 template <typename Metric>
-ResultList BKTreeNode<Metric>::_find_wrapper(std::string_view value, int limit,
-                                             const metric_type &metric) const {
-  ResultList output;
-  _find(output, value, limit, metric);
-  return output;
+void BKTreeNode<Metric>::_find_batch(const std::vector<BatchQuery> &queries,
+                                     batch_stack &active, size_t begin, int limit,
+                                     const metric_type &metric) const {
+  const size_t end = active.size();
+  for (size_t i = begin; i < end; ++i) {
+    const BatchQuery &batch = queries[active[i].first];
+    if (_prunable(batch.query, limit, metric)) {
+      continue;
+    }
+    const int distance = batch.query.prepared(m_word);
+    if (distance <= limit) {
+      batch.output->emplace_back(std::string_view(m_word), distance);
+    }
+    active.emplace_back(active[i].first, distance);
+  }
+  const size_t evaluated = active.size();
+  for (auto const &[dist, node] : m_children) {
+    for (size_t i = end; i < evaluated; ++i) {
+      if (std::abs(dist - active[i].second) <= limit) {
+        active.emplace_back(active[i].first, 0);
+      }
+    }
+    if (active.size() > evaluated) {
+      node->_find_batch(queries, active, evaluated, limit, metric);
+      active.resize(evaluated);
+    }
+  }
+  active.resize(end);
+}
+
+template <typename Metric>
+void BKTreeNode<Metric>::_serialize(std::ostream &out) const {
+  helpers::write_raw(out, static_cast<std::uint32_t>(m_word.size()));
+  out.write(m_word.data(), static_cast<std::streamsize>(m_word.size()));
+  helpers::write_raw(out, static_cast<std::uint32_t>(m_children.size()));
+  for (auto const &[dist, node] : m_children) {
+    helpers::write_raw(out, static_cast<std::int32_t>(dist));
+    node->_serialize(out);
+  }
+}
+
+template <typename Metric>
+auto BKTreeNode<Metric>::_deserialize(std::istream &in, allocator_type allocator,
+                                      std::string &buffer, size_t &count)
+    -> node_pointer {
+  buffer.resize(helpers::read_raw<std::uint32_t>(in));
+  if (!in.read(buffer.data(), static_cast<std::streamsize>(buffer.size()))) {
+    throw std::runtime_error("bk_tree: truncated input");
+  }
+  node_pointer node = _make(buffer, allocator);
+  ++count;
+  const auto children = helpers::read_raw<std::uint32_t>(in);
+  for (std::uint32_t i = 0; i < children; ++i) {
+    const auto dist = helpers::read_raw<std::int32_t>(in);
+    node->m_children.emplace_hint(node->m_children.end(), dist,
+                                  _deserialize(in, allocator, buffer, count));
+  }
+  return node;
 }
 
 template <typename Metric>
 bool BKTree<Metric>::insert(std::string_view value) {
   bool inserted = false;
+  if (m_index == nullptr || !m_index->contains(value)) {
+    inserted = _insert(value, false, _pivot_distances(value, m_pivot_scratch));
+  }
+  if (inserted && m_index != nullptr) {
+    _index_add(value);
+  }
+  return inserted;
+}
+
+/**
+ * @brief Inserts a word whose pivot distances are already known
+ */
+template <typename Metric>
+bool BKTree<Metric>::_insert(std::string_view value, bool borrowed,
+                             std::span<const int> pivots) {
+  bool inserted = false;
   if (m_root == nullptr) {
-    m_root = std::unique_ptr<node_type>(new node_type(value));
-    ++m_tree_size;
-    inserted = true;
-  } else if (m_root->_insert(value, m_metric)) {
-    ++m_tree_size;
+    m_root = node_type::_make(value, get_allocator(), borrowed, pivots);
     inserted = true;
+  } else {
+    inserted = m_root->_insert(value, m_metric, borrowed, pivots);
+  }
+  m_tree_size += inserted;
+  return inserted;
+}
+
+template <typename Metric>
+std::span<const int> BKTree<Metric>::_pivot_distances(std::string_view value,
+                                                      std::vector<int> &scratch) const {
+  scratch.resize(m_pivots.size());
+  for (size_t i = 0; i < m_pivots.size(); ++i) {
+    scratch[i] = m_metric(value, m_pivots[i]);
+  }
+  return scratch;
+}
+
+/**
+ * @brief Inserts `values` in order, viewing the words instead of copying them
+ *
+ * `storage` owns the bytes the views point into and is kept alive by the tree.
+ * With `thread_count > 1` and a tree without children yet, every word is first
+ * bucketed by its distance to the root and the buckets are then built on
+ * `thread_count` threads. Buckets are disjoint subtrees filled in input order,
+ * so the result is the same tree as inserting sequentially. The tree's memory
+ * resource must then be thread-safe, as the default one is. With the membership
+ * index, words already present or repeated in `values` are skipped.
+ *
+ * @return the number of words inserted
+ */
+template <typename Metric>
+size_t BKTree<Metric>::insert_views(std::span<const std::string_view> values,
+                                    std::shared_ptr<const void> storage,
+                                    size_t thread_count) {
+  if (storage != nullptr) {
+    m_storage.push_back(std::move(storage));
+  }
+  std::vector<std::string_view> fresh;
+  if (m_index != nullptr) {
+    for (auto value : values) {
+      if (!m_index->contains(value)) {
+        _index_add(value);
+        fresh.push_back(value);
+      }
+    }
+    values = fresh;
+  }
+  const size_t requested = values.size();
+  size_t inserted = 0;
+  if (m_root == nullptr && !values.empty()) {
+    m_root = node_type::_make(values.front(), get_allocator(), true,
+                              _pivot_distances(values.front(), m_pivot_scratch));
+    values = values.subspan(1);
+    ++inserted;
+  }
+  // Sequential for small (or empty) inputs, and when existing children would
+  // have to be merged into
+  if (thread_count <= 1 || values.size() < thread_count ||
+      !m_root->m_children.empty()) {
+    for (auto value : values) {
+      inserted += m_root->_insert(value, m_metric, true,
+                                  _pivot_distances(value, m_pivot_scratch));
+    }
+    m_tree_size += inserted;
+    // Words the metric rejected were indexed all the same
+    if (m_index != nullptr && inserted < requested) {
+      _reindex();
+    }
+    return inserted;
+  }
+
+  std::vector<int> distances(values.size());
+  _in_parallel(thread_count, [&](size_t worker) {
+    for (size_t i = worker; i < values.size(); i += thread_count) {
+      distances[i] = m_metric(values[i], m_root->m_word);
+    }
+  });
+  std::map<int, std::vector<size_t>> buckets;
+  for (size_t i = 0; i < values.size(); ++i) {
+    if (distances[i] >= 0) {
+      buckets[distances[i]].push_back(i);
+    }
+  }
+  // Largest buckets first, so that the last one to finish is a small one
+  std::vector<std::pair<node_type *, const std::vector<size_t> *>> subtrees;
+  for (auto const &[distance, bucket] : buckets) {
+    auto &child = m_root->m_children[distance];
+    const std::string_view first = values[bucket.front()];
+    child = node_type::_make(first, get_allocator(), true,
+                             _pivot_distances(first, m_pivot_scratch));
+    subtrees.emplace_back(child.get(), &bucket);
+  }
+  std::sort(subtrees.begin(), subtrees.end(), [](auto const &a, auto const &b) {
+    return a.second->size() > b.second->size();
+  });
+  std::atomic<size_t> next = 0, total = subtrees.size();
+  _in_parallel(thread_count, [&](size_t) {
+    for (size_t i = next.fetch_add(1); i < subtrees.size(); i = next.fetch_add(1)) {
+      auto [child, bucket] = subtrees[i];
+      size_t count = 0;
+      std::vector<int> scratch;
+      for (size_t j = 1; j < bucket->size(); ++j) {
+        const std::string_view value = values[(*bucket)[j]];
+        count += child->_insert(value, m_metric, true,
+                                _pivot_distances(value, scratch));
+      }
+      total.fetch_add(count);
+    }
+  });
+  inserted += total.load();
+  m_tree_size += inserted;
+  if (m_index != nullptr && inserted < requested) {
+    _reindex();
   }
   return inserted;
 }
@@ -560,12 +2223,12 @@ bool BKTree<Metric>::insert(std::string_view value) {
 template <typename Metric>
 bool BKTree<Metric>::erase(std::string_view value) {
   bool erased = false;
-  if (m_root == nullptr) {
+  if (m_root == nullptr || (m_index != nullptr && !m_index->contains(value))) {
     erased = false;
   } else if (m_root->m_word == value) {
     if (m_tree_size > 1) {
       auto &replacement_node = m_root->m_children.begin()->second;
-      std::queue<std::unique_ptr<node_type> const *> bq;
+      std::queue<node_pointer const *> bq;
       for (bool first = true; auto const &[_, node] : m_root->m_children) {
         if (first) {
           first = false;
@@ -579,7 +2242,9 @@ bool BKTree<Metric>::erase(std::string_view value) {
         for (auto const &[_, child] : (*node)->m_children) {
           bq.push(&child);
         }
-        replacement_node->_insert((*node)->m_word, m_metric);
+        replacement_node->_insert((*node)->m_word, m_metric, (*node)->m_borrowed,
+                                  (*node)->_pivots());
+        ++m_relinked;
       }
       m_root = std::move(replacement_node);
     } else {
@@ -587,19 +2252,541 @@ bool BKTree<Metric>::erase(std::string_view value) {
     }
     --m_tree_size;
     erased = true;
-  } else if (m_root->_erase(value, m_metric)) {
+  } else if (m_root->_erase(value, m_metric, m_relinked)) {
     --m_tree_size;
     erased = true;
   }
+  if (erased && m_index != nullptr) {
+    _index_remove(value);
+  }
+  if (erased && m_policy.due(degradation(), m_tree_size)) {
+    rebuild();
+  }
+  return erased;
+}
+
+/**
+ * @brief Erases every word for which `pred` holds; returns the number erased
+ *
+ * Unlike a loop over erase, which re-inserts the subtree below each erased
+ * node, every node is tested once and each survivor below an erased node is
+ * relinked once (see BKTreeNode::_sweep). `pred` must not modify the tree.
+ */
+template <typename Metric>
+template <typename Predicate>
+requires std::predicate<Predicate &, std::string_view>
+size_t BKTree<Metric>::erase_if(Predicate pred) {
+  if (m_root == nullptr) {
+    return 0;
+  }
+  auto victim = [&](std::string_view word) {
+    if (!pred(word)) {
+      return false;
+    }
+    if (m_index != nullptr) {
+      _index_remove(word);
+    }
+    return true;
+  };
+  size_t erased = 0;
+  std::vector<node_pointer> orphans;
+  const bool root_erased = victim(m_root->m_word);
+  m_root->_sweep(victim, m_metric, erased, m_relinked, orphans);
+  if (root_erased) {
+    // Replaced by its first child, as in erase
+    ++erased;
+    auto spare = [](std::string_view) { return false; };
+    node_pointer old = std::move(m_root);
+    for (auto &[_, child] : old->m_children) {
+      if (m_root == nullptr) {
+        m_root = std::move(child);
+      } else {
+        node_type::_detach(std::move(child), spare, erased, orphans);
+      }
+    }
+    if (m_root == nullptr && !orphans.empty()) {
+      m_root = std::move(orphans.back());
+      orphans.pop_back();
+    }
+  }
+  for (auto &orphan : orphans) {
+    static_cast<void>(m_root->_merge(std::move(orphan), m_metric));
+  }
+  m_relinked += orphans.size();
+  m_tree_size -= erased;
+  if (erased > 0 && m_policy.due(degradation(), m_tree_size)) {
+    rebuild();
+  }
   return erased;
 }
 
+/**
+ * @brief Whether the tree holds `value`
+ *
+ * One hash lookup with the membership index; otherwise one distance per level
+ * along the path insert would take (see BKTreeNode::_locate), never a search.
+ */
+template <typename Metric>
+bool BKTree<Metric>::contains(std::string_view value) const {
+  if (m_index != nullptr) {
+    return m_index->contains(value);
+  }
+  return m_root != nullptr && m_root->_locate(value, m_metric) != nullptr;
+}
+
+template <typename Metric>
+void BKTree<Metric>::set_membership_index(bool enabled) {
+  if (!enabled) {
+    m_index.reset();
+  } else if (m_index == nullptr) {
+    m_index = std::make_unique<membership_index>(get_allocator());
+    _reindex();
+  }
+}
+
+template <typename Metric>
+void BKTree<Metric>::_index_add(std::string_view value) {
+  auto it = m_index->find(value);
+  if (it == m_index->end()) {
+    m_index->emplace(std::pmr::string(value, get_allocator()), 1);
+  } else {
+    ++it->second;
+  }
+}
+
+template <typename Metric>
+void BKTree<Metric>::_index_remove(std::string_view value) {
+  auto it = m_index->find(value);
+  if (--it->second == 0) {
+    m_index->erase(it);
+  }
+}
+
+/**
+ * @brief Refills the membership index from every node of the tree
+ */
+template <typename Metric>
+void BKTree<Metric>::_reindex() {
+  m_index->clear();
+  m_index->reserve(m_tree_size);
+  std::vector<const node_type *> nodes;
+  if (m_root != nullptr) {
+    nodes.push_back(m_root.get());
+  }
+  while (!nodes.empty()) {
+    const node_type *node = nodes.back();
+    nodes.pop_back();
+    _index_add(node->m_word);
+    for (auto const &[_, child] : node->m_children) {
+      nodes.push_back(child.get());
+    }
+  }
+}
+
+template <typename Metric>
+void BKTree<Metric>::set_pivots(std::vector<std::string> pivots) {
+  if (pivots.size() > std::numeric_limits<std::uint16_t>::max()) {
+    throw std::length_error("bk_tree: too many pivots");
+  }
+  m_pivots = std::move(pivots);
+  // Each node is remade with its new distances and takes over the children of
+  // the old one, so the layout is kept
+  std::vector<node_pointer *> slots;
+  if (m_root != nullptr) {
+    slots.push_back(&m_root);
+  }
+  while (!slots.empty()) {
+    node_pointer &slot = *slots.back();
+    slots.pop_back();
+    node_pointer old = std::move(slot);
+    slot = node_type::_make(old->m_word, get_allocator(), old->m_borrowed,
+                            _pivot_distances(old->m_word, m_pivot_scratch));
+    slot->m_children = std::move(old->m_children);
+    for (auto &[_, child] : slot->m_children) {
+      slots.push_back(&child);
+    }
+  }
+}
+
+/**
+ * @brief Picks up to `count` pivots far apart from each other and sets them
+ *
+ * Greedy maximum-sum selection, as in LAESA, over at most BK_PIVOT_CANDIDATES
+ * words spread across the tree: each pivot is the candidate with the largest
+ * sum of distances to the pivots already picked, starting from the root.
+ */
+template <typename Metric>
+void BKTree<Metric>::select_pivots(size_t count) {
+  std::vector<const node_type *> nodes;
+  if (m_root != nullptr) {
+    nodes.push_back(m_root.get());
+  }
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    for (auto const &[_, child] : nodes[i]->m_children) {
+      nodes.push_back(child.get());
+    }
+  }
+  std::vector<std::string_view> candidates;
+  const size_t stride = std::max<size_t>(1, nodes.size() / BK_PIVOT_CANDIDATES);
+  for (size_t i = 0; i < nodes.size(); i += stride) {
+    candidates.push_back(nodes[i]->m_word);
+  }
+  std::vector<std::string> pivots;
+  std::vector<long long> separation(candidates.size(), 0);
+  size_t next = 0;
+  while (pivots.size() < std::min(count, candidates.size())) {
+    const std::string_view pivot = candidates[next];
+    pivots.emplace_back(pivot);
+    separation[next] = -1;
+    for (size_t i = 0; i < candidates.size(); ++i) {
+      if (separation[i] >= 0) {
+        separation[i] += std::max<int>(0, m_metric(candidates[i], pivot));
+        next = separation[i] > separation[next] ? i : next;
+      }
+    }
+  }
+  set_pivots(std::move(pivots));
+}
+
+/**
+ * @brief Moves every word of `other` into this tree and leaves `other` empty
+ *
+ * With the same memory resource no node is allocated or copied: the larger
+ * tree keeps its layout, and the nodes of the smaller one are relinked into it,
+ * grafting whole subtrees below nodes holding the same word (see
+ * BKTreeNode::_merge). Otherwise, or when the trees have different pivots, the
+ * words are inserted one by one. Words the metric rejects are dropped as insert
+ * would. With the membership index, words this tree already holds, and repeats
+ * within `other`, are erased from `other` first and not added.
+ *
+ * @return the number of words added
+ */
+template <typename Metric>
+size_t BKTree<Metric>::merge(BKTree &&other) {
+  if (this == &other || other.m_root == nullptr) {
+    return 0;
+  }
+  m_storage.insert(m_storage.end(), std::make_move_iterator(other.m_storage.begin()),
+                   std::make_move_iterator(other.m_storage.end()));
+  other.m_storage.clear();
+  const size_t before = m_tree_size;
+  size_t admitted = 0;
+  if (m_index != nullptr) {
+    // Keeps the first copy of each word new to this tree, and indexes it
+    static_cast<void>(other.erase_if([&](std::string_view word) {
+      if (m_index->contains(word)) {
+        return true;
+      }
+      _index_add(word);
+      ++admitted;
+      return false;
+    }));
+    if (other.m_root == nullptr) {
+      return 0;
+    }
+  }
+  const bool same_pivots = m_pivots == other.m_pivots;
+  if (m_resource->is_equal(*other.m_resource) && same_pivots) {
+    if (m_tree_size < other.m_tree_size) {
+      std::swap(m_root, other.m_root);
+      std::swap(m_tree_size, other.m_tree_size);
+      std::swap(m_relinked, other.m_relinked);
+    }
+    if (other.m_root != nullptr) {
+      const size_t dropped = m_root->_merge(std::move(other.m_root), m_metric);
+      m_tree_size += other.m_tree_size - dropped;
+    }
+  } else {
+    std::queue<node_pointer const *> bq;
+    bq.push(&other.m_root);
+    while (!bq.empty()) {
+      auto *node = bq.front();
+      bq.pop();
+      for (auto const &[_, child] : (*node)->m_children) {
+        bq.push(&child);
+      }
+      _insert((*node)->m_word, (*node)->m_borrowed,
+              same_pivots ? (*node)->_pivots()
+                          : _pivot_distances((*node)->m_word, m_pivot_scratch));
+    }
+    other.m_root.reset();
+  }
+  other.m_relinked = 0;
+  other.m_tree_size = 0;
+  // Words the metric rejected were indexed all the same
+  if (m_index != nullptr && m_tree_size - before < admitted) {
+    _reindex();
+  }
+  if (other.m_index != nullptr) {
+    other.m_index->clear();
+  }
+  return m_tree_size - before;
+}
+
+/**
+ * @brief Builds a fresh tree holding the same words, in a shuffled order
+ *
+ * Only reads this tree, so a rebuild can run on another thread alongside
+ * finds and be moved in afterwards. The copy shares the memory resource, the
+ * policy, the pivots, the membership index setting and any borrowed storage.
+ */
+template <typename Metric>
+BKTree<Metric> BKTree<Metric>::rebuilt() const {
+  BKTree tree(m_metric, get_allocator());
+  tree.m_storage = m_storage;
+  tree.m_policy = m_policy;
+  std::vector<const node_type *> nodes;
+  if (m_root != nullptr) {
+    nodes.push_back(m_root.get());
+  }
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    for (auto const &[_, child] : nodes[i]->m_children) {
+      nodes.push_back(child.get());
+    }
+  }
+  // A random order keeps the expected depth logarithmic
+  std::shuffle(nodes.begin(), nodes.end(), std::mt19937(nodes.size()));
+  tree.m_pivots = m_pivots;
+  for (const node_type *node : nodes) {
+    tree._insert(node->m_word, node->m_borrowed, node->_pivots());
+  }
+  tree.set_membership_index(has_membership_index());
+  return tree;
+}
+
+/**
+ * @brief Calls `fn(word)` for every word of the tree, from up to
+ * `thread_count` threads
+ *
+ * The calling thread visits the top levels until they leave at least
+ * BK_PARALLEL_SUBTREES subtrees per thread; the threads then take the subtrees
+ * one at a time, so that a thread done with a small one moves on to the next.
+ * `fn` is called concurrently, in no particular order, and the tree must not
+ * be modified meanwhile. If `fn` throws, the threads stop taking subtrees and
+ * the first exception is rethrown.
+ */
+template <typename Metric>
+template <typename Function>
+requires std::invocable<Function &, std::string_view>
+void BKTree<Metric>::parallel_for_each(Function fn, size_t thread_count) const {
+  if (m_root == nullptr) {
+    return;
+  }
+  thread_count = std::max<size_t>(thread_count, 1);
+  std::vector<const node_type *> subtrees{m_root.get()}, level;
+  while (thread_count > 1 && subtrees.size() < thread_count * BK_PARALLEL_SUBTREES) {
+    level.clear();
+    for (const node_type *node : subtrees) {
+      fn(node->m_word);
+      for (auto const &[_, child] : node->m_children) {
+        level.push_back(child.get());
+      }
+    }
+    if (level.empty()) {
+      return;
+    }
+    std::swap(subtrees, level);
+  }
+
+  std::atomic<size_t> next = 0;
+  std::atomic<bool> failed = false;
+  _in_parallel(std::min(thread_count, subtrees.size()), [&](size_t) {
+    try {
+      for (size_t i = next.fetch_add(1); i < subtrees.size() && !failed.load();
+           i = next.fetch_add(1)) {
+        for (auto word : WordView<Traversal::depth_first>(subtrees[i])) {
+          fn(word);
+        }
+      }
+    } catch (...) {
+      failed.store(true);
+      throw;
+    }
+  });
+}
+
+/**
+ * @brief Writes the tree's structure: a header, then the nodes in preorder
+ *
+ * Each node is its word (32-bit length and bytes) and its children as pairs
+ * of 32-bit distance and node. Integers are in native byte order.
+ */
+template <typename Metric>
+void BKTree<Metric>::serialize(std::ostream &out) const {
+  out.write(serial_magic.data(), serial_magic.size());
+  helpers::write_raw(out, static_cast<std::uint64_t>(m_tree_size));
+  if (m_root != nullptr) {
+    m_root->_serialize(out);
+  }
+}
+
+/**
+ * @brief Rebuilds a tree written by serialize without evaluating the metric
+ *
+ * Throws `std::runtime_error` on malformed input.
+ */
+template <typename Metric>
+BKTree<Metric> BKTree<Metric>::deserialize(std::istream &in,
+                                           const metric_type &distance,
+                                           allocator_type allocator) {
+  char magic[serial_magic.size()];
+  if (!in.read(magic, sizeof(magic)) ||
+      std::string_view(magic, sizeof(magic)) != serial_magic) {
+    throw std::runtime_error("bk_tree: not a serialized tree");
+  }
+  BKTree tree(distance, allocator);
+  const auto size = helpers::read_raw<std::uint64_t>(in);
+  if (size > 0) {
+    std::string buffer;
+    size_t count = 0;
+    tree.m_root = node_type::_deserialize(in, allocator, buffer, count);
+    if (count != size) {
+      throw std::runtime_error("bk_tree: node count mismatch");
+    }
+  }
+  tree.m_tree_size = size;
+  return tree;
+}
+
 template <typename Metric>
 ResultList BKTree<Metric>::find(std::string_view value, int limit) const {
+  ResultList output;
+  if (m_root != nullptr) {
+    std::vector<int> pivots(m_pivots.size());
+    const query_type query = _query(value, pivots);
+    m_root->_find(output, query, limit, m_metric);
+    _count_skips(query);
+  }
+  return output;
+}
+
+/**
+ * @brief Appends the matches to `output`, allocating words from its resource
+ */
+template <typename Metric>
+void BKTree<Metric>::find(std::string_view value, int limit,
+                          pmr::ResultList &output) const {
+  if (m_root != nullptr) {
+    std::vector<int> pivots(m_pivots.size());
+    const query_type query = _query(value, pivots);
+    m_root->_find(output, query, limit, m_metric);
+    _count_skips(query);
+  }
+}
+
+/**
+ * @brief Lazily yields the same entries as find, in the same order
+ *
+ * The traversal uses an explicit stack and only advances when the consumer asks
+ * for the next entry, so breaking out early skips the rest of the tree. `value`
+ * must outlive the generator, and the tree must not be modified while it is in
+ * use.
+ */
+template <typename Metric>
+helpers::Generator<ResultEntry> BKTree<Metric>::find_lazy(std::string_view value,
+                                                          int limit) const {
   if (m_root == nullptr) {
-    return ResultList{};
+    co_return;
   }
-  return m_root->_find_wrapper(value, limit, m_metric);
+  std::vector<int> pivots(m_pivots.size());
+  const query_type query = _query(value, pivots);
+  std::vector<const node_type *> stack{m_root.get()};
+  while (!stack.empty()) {
+    const node_type *node = stack.back();
+    stack.pop_back();
+    // As BKTreeNode::_find
+    const auto [lower, upper] = node->_bounds(query, limit, m_metric);
+    if (lower > limit) {
+      auto children = node->_candidates(lower, upper, limit);
+      // Skips are counted as they happen, since the consumer may stop at any point
+      if (children.empty()) {
+        if (node->_pruned_by_pivots(query, limit, m_metric)) {
+          m_pivot_skips.fetch_add(1, std::memory_order_relaxed);
+        }
+        continue;
+      }
+      if (!query.pivots.empty()) {
+        m_pivot_skips.fetch_add(1, std::memory_order_relaxed);
+        for (auto const &[_, child] : children | std::views::reverse) {
+          stack.push_back(child.get());
+        }
+        continue;
+      }
+    }
+    const int distance = query.prepared(node->m_word);
+    for (auto it = node->m_children.rbegin(); it != node->m_children.rend(); ++it) {
+      if (std::abs(it->first - distance) <= limit) {
+        stack.push_back(it->second.get());
+      }
+    }
+    if (distance <= limit) {
+      co_yield ResultEntry{std::string(node->m_word), distance};
+    }
+  }
+}
+
+/**
+ * @brief Runs find best-first until it is done or `budget` runs out
+ *
+ * Candidates are visited in order of a lower bound on their distance to the
+ * query: the largest gap along their path between an edge label and the
+ * query's distance to that edge's parent, and the metric's and the pivots'
+ * bounds on the node itself. Only the gaps hold for the whole subtree, so only
+ * they are passed down to children.
+ * The nodes likeliest to match come first and the words found early tend to be
+ * the closest ones. Stops before evaluating the metric past
+ * `budget.max_evaluations` or `budget.deadline`, and then clears `complete`.
+ * Results are sorted by distance; with a sufficient budget they are the same
+ * entries as find.
+ */
+template <typename Metric>
+BoundedResultList BKTree<Metric>::find_bounded(std::string_view value, int limit,
+                                               const SearchBudget &budget) const {
+  BoundedResultList output;
+  if (m_root == nullptr) {
+    return output;
+  }
+  std::vector<int> pivots(m_pivots.size());
+  const query_type query = _query(value, pivots);
+  output.evaluations = m_pivots.size();
+  // (lower bound on the distance, arrival order, node, largest edge gap on its
+  // path), closest first
+  using candidate = std::tuple<int, size_t, const node_type *, int>;
+  std::priority_queue<candidate, std::vector<candidate>, std::greater<>> frontier;
+  size_t arrivals = 0;
+  frontier.emplace(0, arrivals++, m_root.get(), 0);
+  while (!frontier.empty()) {
+    const node_type *node = std::get<2>(frontier.top());
+    const int gap = std::get<3>(frontier.top());
+    if (node->_prunable(query, limit, m_metric)) {
+      frontier.pop();
+      continue;
+    }
+    if (output.evaluations >= budget.max_evaluations ||
+        (budget.deadline && std::chrono::steady_clock::now() >= *budget.deadline)) {
+      output.complete = false;
+      break;
+    }
+    frontier.pop();
+    const int distance = query.prepared(node->m_word);
+    ++output.evaluations;
+    if (distance <= limit) {
+      output.results.emplace_back(node->m_word, distance);
+    }
+    for (auto const &[dist, child] : node->m_children) {
+      if (std::abs(dist - distance) <= limit) {
+        const int path_gap = std::max(gap, std::abs(dist - distance));
+        const int lower =
+            std::max(path_gap, child->_bounds(query, limit, m_metric).first);
+        frontier.emplace(lower, arrivals++, child.get(), path_gap);
+      }
+    }
+  }
+  _count_skips(query);
+  std::stable_sort(
+      output.results.begin(), output.results.end(),
+      [](const ResultEntry &a, const ResultEntry &b) { return a.second < b.second; });
+  return output;
 }
 
 } // namespace bk_tree
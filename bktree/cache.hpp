@@ -0,0 +1,230 @@
+//
+// bk-tree   Header-only Burkhard-Keller tree library
+// Copyright (C) 2020-2023  John Law
+//
+// This file is part of bk-tree.
+//
+// bk-tree is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// bk-tree is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with bk-tree.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include "bktree.hpp"
+
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+#ifndef BK_CACHE_DEFAULT_CAPACITY
+#define BK_CACHE_DEFAULT_CAPACITY 4096
+#endif
+
+#ifndef BK_CACHE_PATCH_BUDGET
+#define BK_CACHE_PATCH_BUDGET 64
+#endif
+
+namespace bk_tree {
+
+/**
+ * @brief BK-tree with a bounded LRU cache of find results
+ *
+ * Results are cached per (query, limit). Rather than dropping the whole cache,
+ * insert and erase patch the affected entries: an inserted word is appended to
+ * every cached result whose query lies within its limit, and an erased word is
+ * removed from every cached result that contains it. Cached results therefore
+ * always hold the same entries as a fresh find, though possibly in a different
+ * order. All member functions are thread-safe; finds run concurrently, while
+ * insert and erase are exclusive.
+ *
+ * Insert runs under the exclusive lock, so it bounds its own metric calls.
+ * Entries the metric's cheap lower bound rules out are left as they are. Of the
+ * rest, the BK_CACHE_PATCH_BUDGET most recently used are patched, and the others
+ * are evicted, to be filled again by their next find. A burst of inserts near
+ * many cached queries thus costs some cache misses rather than blocking readers
+ * for a metric call per cached entry.
+ */
+template <typename Metric>
+class CachedBKTree {
+  using metric_type = Metric;
+  using tree_type = BKTree<metric_type>;
+
+public:
+  explicit CachedBKTree(size_t capacity = BK_CACHE_DEFAULT_CAPACITY,
+                        const metric_type &distance = Metric())
+      : m_tree(distance), m_metric(distance), m_capacity(capacity) {}
+
+  CachedBKTree(const CachedBKTree &) = delete;
+  CachedBKTree &operator=(const CachedBKTree &) = delete;
+
+  bool insert(std::string_view value);
+  bool erase(std::string_view value);
+  [[nodiscard]] ResultList find(std::string_view value, int limit) const;
+
+  size_t size() const {
+    std::shared_lock lock(m_tree_mutex);
+    return m_tree.size();
+  }
+  bool empty() const { return size() == 0; }
+
+  size_t capacity() const noexcept { return m_capacity; }
+  size_t cache_size() const {
+    std::lock_guard lock(m_cache_mutex);
+    return m_entries.size();
+  }
+  size_t cache_hits() const noexcept { return m_hits.load(std::memory_order_relaxed); }
+  size_t cache_misses() const noexcept {
+    return m_misses.load(std::memory_order_relaxed);
+  }
+  void clear_cache();
+
+private:
+  struct Entry {
+    std::string query;
+    int limit;
+    ResultList results;
+    metrics::WordSketch sketch;
+  };
+
+  struct Key {
+    std::string_view query;
+    int limit;
+    friend bool operator==(const Key &, const Key &) = default;
+  };
+
+  struct KeyHash {
+    size_t operator()(const Key &key) const noexcept {
+      return std::hash<std::string_view>{}(key.query) ^
+             (std::hash<int>{}(key.limit) * 0x9e3779b97f4a7c15ULL);
+    }
+  };
+
+  using entry_list = std::list<Entry>;
+
+  tree_type m_tree;
+  const metric_type m_metric;
+  const size_t m_capacity;
+
+  mutable std::shared_mutex m_tree_mutex;
+  mutable std::mutex m_cache_mutex;
+  // Keys view the query strings owned by the list entries
+  mutable entry_list m_entries;
+  mutable std::unordered_map<Key, typename entry_list::iterator, KeyHash> m_index;
+  mutable size_t m_generation = 0;
+  mutable std::atomic<size_t> m_hits = 0, m_misses = 0;
+};
+
+template <typename Metric>
+bool CachedBKTree<Metric>::insert(std::string_view value) {
+  std::unique_lock tree_lock(m_tree_mutex);
+  if (!m_tree.insert(value)) {
+    return false;
+  }
+  std::lock_guard lock(m_cache_mutex);
+  ++m_generation;
+  const metrics::WordSketch sketch(value);
+  size_t budget = BK_CACHE_PATCH_BUDGET;
+  // Most recently used first, so the entries evicted are the coldest
+  for (auto it = m_entries.begin(); it != m_entries.end();) {
+    Entry &entry = *it;
+    if constexpr (helpers::has_bounds<Metric>) {
+      if (static_cast<int>(m_metric.lower_bound(sketch, entry.sketch)) > entry.limit) {
+        ++it;
+        continue;
+      }
+    }
+    if (budget == 0) {
+      m_index.erase(Key{entry.query, entry.limit});
+      it = m_entries.erase(it);
+      continue;
+    }
+    --budget;
+    const int distance = m_metric(entry.query, value);
+    if (distance <= entry.limit) {
+      entry.results.push_back({std::string(value), distance});
+    }
+    ++it;
+  }
+  return true;
+}
+
+template <typename Metric>
+bool CachedBKTree<Metric>::erase(std::string_view value) {
+  std::unique_lock tree_lock(m_tree_mutex);
+  if (!m_tree.erase(value)) {
+    return false;
+  }
+  std::lock_guard lock(m_cache_mutex);
+  ++m_generation;
+  for (auto &entry : m_entries) {
+    auto it = std::find_if(entry.results.begin(), entry.results.end(),
+                           [value](const ResultEntry &p) { return p.first == value; });
+    if (it != entry.results.end()) {
+      entry.results.erase(it);
+    }
+  }
+  return true;
+}
+
+template <typename Metric>
+ResultList CachedBKTree<Metric>::find(std::string_view value, int limit) const {
+  {
+    std::lock_guard lock(m_cache_mutex);
+    auto it = m_index.find(Key{value, limit});
+    if (it != m_index.end()) {
+      m_entries.splice(m_entries.begin(), m_entries, it->second);
+      m_hits.fetch_add(1, std::memory_order_relaxed);
+      return it->second->results;
+    }
+  }
+  m_misses.fetch_add(1, std::memory_order_relaxed);
+  if (m_capacity == 0) {
+    std::shared_lock tree_lock(m_tree_mutex);
+    return m_tree.find(value, limit);
+  }
+
+  ResultList results;
+  size_t generation;
+  {
+    std::shared_lock tree_lock(m_tree_mutex);
+    results = m_tree.find(value, limit);
+    std::lock_guard lock(m_cache_mutex);
+    generation = m_generation;
+  }
+
+  std::lock_guard lock(m_cache_mutex);
+  // A writer got in between the lookup and now, or another thread cached the
+  // same key first; either way this result must not be stored.
+  if (generation != m_generation || m_index.contains(Key{value, limit})) {
+    return results;
+  }
+  if (m_entries.size() == m_capacity) {
+    m_index.erase(Key{m_entries.back().query, m_entries.back().limit});
+    m_entries.pop_back();
+  }
+  m_entries.push_front(
+      Entry{std::string(value), limit, results, metrics::WordSketch(value)});
+  m_index.emplace(Key{m_entries.front().query, limit}, m_entries.begin());
+  return results;
+}
+
+template <typename Metric>
+void CachedBKTree<Metric>::clear_cache() {
+  std::lock_guard lock(m_cache_mutex);
+  m_index.clear();
+  m_entries.clear();
+}
+
+} // namespace bk_tree
@@ -0,0 +1,234 @@
+//
+// bk-tree   Header-only Burkhard-Keller tree library
+// Copyright (C) 2020-2023  John Law
+//
+// This file is part of bk-tree.
+//
+// bk-tree is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// bk-tree is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with bk-tree.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include "bktree.hpp"
+
+#ifndef BK_COMPACT_BLOCK_SIZE
+#define BK_COMPACT_BLOCK_SIZE 8
+#endif
+
+namespace bk_tree {
+
+namespace helpers {
+
+/**
+ * @brief Appends `value` as a LEB128 varint: seven bits per byte, low bits
+ * first, the high bit set on every byte but the last
+ */
+inline void write_varint(std::vector<char> &out, size_t value) {
+  for (; value >= 0x80; value >>= 7) {
+    out.push_back(static_cast<char>(value | 0x80));
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+/**
+ * @brief Reads a varint written by write_varint and moves `in` past it
+ */
+inline size_t read_varint(const char *&in) noexcept {
+  size_t value = 0;
+  for (unsigned shift = 0;; shift += 7) {
+    const auto byte = static_cast<unsigned char>(*in++);
+    value |= static_cast<size_t>(byte & 0x7f) << shift;
+    if (byte < 0x80) {
+      return value;
+    }
+  }
+}
+
+} // namespace helpers
+
+/**
+ * @brief Frozen BKTree whose words are front-coded, for dictionaries too large
+ * to hold as nodes
+ *
+ * The tree keeps the shape of the BKTree it is built from, but its nodes are
+ * flat arrays in breadth-first order: a word id, the distance to the parent
+ * and the index of the first child, 12 bytes in all, so that the children of
+ * a node are contiguous and sorted by distance. The distinct words are sorted
+ * and front-coded in blocks of BK_COMPACT_BLOCK_SIZE: the first word of a
+ * block is stored whole, every other one as the length of the prefix it shares
+ * with its predecessor and the rest of its bytes. Duplicates share their word.
+ *
+ * find decodes a word into per-query scratch when it evaluates its node,
+ * which costs up to BK_COMPACT_BLOCK_SIZE - 1 prefix copies; larger blocks
+ * save more on long shared prefixes and cost more per evaluation. Results
+ * equal those of BKTree::find on the source tree; pivots are not kept.
+ */
+template <typename Metric>
+class CompactBKTree {
+  static_assert(helpers::is_metric<Metric>::value, "Metric must be of type Distance");
+
+  using metric_type = Metric;
+  using id_type = std::uint32_t;
+
+public:
+  explicit CompactBKTree(const BKTree<Metric> &tree);
+
+  template <typename Range>
+  requires std::ranges::input_range<Range> &&
+      std::convertible_to<std::ranges::range_reference_t<Range>, std::string_view>
+  explicit CompactBKTree(Range &&values, const metric_type &distance = Metric())
+      : CompactBKTree(build(std::forward<Range>(values), distance)) {}
+
+  CompactBKTree(std::initializer_list<std::string_view> list)
+      : CompactBKTree(std::span<const std::string_view>(list)) {}
+
+  size_t size() const noexcept { return m_word_ids.size(); }
+  bool empty() const noexcept { return m_word_ids.empty(); }
+  [[nodiscard]] ResultList find(std::string_view value, int limit) const;
+
+  /**
+   * @brief Bytes held by the tree, words and nodes together
+   */
+  size_t memory_usage() const noexcept {
+    return m_data.capacity() + m_blocks.capacity() * sizeof(size_t) +
+           (m_word_ids.capacity() + m_first_child.capacity()) * sizeof(id_type) +
+           m_keys.capacity() * sizeof(int);
+  }
+
+private:
+  template <typename Range>
+  static BKTree<Metric> build(Range &&values, const metric_type &distance) {
+    BKTree<Metric> tree(distance);
+    for (auto &&value : values) {
+      tree.insert(value);
+    }
+    return tree;
+  }
+
+  std::string_view _word(id_type id, std::string &scratch) const;
+
+  const metric_type m_metric;
+  // Front-coded words, and the offset of each block in m_data
+  std::vector<char> m_data;
+  std::vector<size_t> m_blocks;
+  // Per node, in breadth-first order; the children of node i are the nodes
+  // m_first_child[i] to m_first_child[i + 1] - 1, and m_keys holds each
+  // node's distance to its parent
+  std::vector<id_type> m_word_ids;
+  std::vector<id_type> m_first_child;
+  std::vector<int> m_keys;
+};
+
+template <typename Metric>
+CompactBKTree<Metric>::CompactBKTree(const BKTree<Metric> &tree)
+    : m_metric(tree.m_metric) {
+  using node_type = typename BKTree<Metric>::node_type;
+  if (tree.size() >= std::numeric_limits<id_type>::max()) {
+    throw std::length_error("bk_tree: too many words for a CompactBKTree");
+  }
+  std::vector<const node_type *> nodes;
+  if (tree.m_root != nullptr) {
+    nodes.push_back(tree.m_root.get());
+    m_keys.push_back(0);
+  }
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    m_first_child.push_back(static_cast<id_type>(nodes.size()));
+    for (auto const &[distance, child] : nodes[i]->m_children) {
+      nodes.push_back(child.get());
+      m_keys.push_back(distance);
+    }
+  }
+  m_first_child.push_back(static_cast<id_type>(nodes.size()));
+
+  std::vector<std::string_view> words;
+  words.reserve(nodes.size());
+  for (const node_type *node : nodes) {
+    words.push_back(node->m_word);
+  }
+  std::sort(words.begin(), words.end());
+  words.erase(std::unique(words.begin(), words.end()), words.end());
+  for (const node_type *node : nodes) {
+    auto it = std::lower_bound(words.begin(), words.end(), node->m_word);
+    m_word_ids.push_back(static_cast<id_type>(it - words.begin()));
+  }
+
+  for (size_t i = 0; i < words.size(); ++i) {
+    std::string_view rest = words[i];
+    if (i % BK_COMPACT_BLOCK_SIZE == 0) {
+      m_blocks.push_back(m_data.size());
+    } else {
+      const std::string_view previous = words[i - 1];
+      const size_t shared = static_cast<size_t>(
+          std::mismatch(previous.begin(), previous.end(), rest.begin(), rest.end())
+              .first -
+          previous.begin());
+      helpers::write_varint(m_data, shared);
+      rest.remove_prefix(shared);
+    }
+    helpers::write_varint(m_data, rest.size());
+    m_data.insert(m_data.end(), rest.begin(), rest.end());
+  }
+  m_data.shrink_to_fit();
+  m_blocks.shrink_to_fit();
+}
+
+/**
+ * @brief Decodes word `id` into `scratch` and views it there
+ */
+template <typename Metric>
+std::string_view CompactBKTree<Metric>::_word(id_type id, std::string &scratch) const {
+  const char *in = m_data.data() + m_blocks[id / BK_COMPACT_BLOCK_SIZE];
+  size_t length = helpers::read_varint(in);
+  scratch.assign(in, length);
+  in += length;
+  for (size_t i = id % BK_COMPACT_BLOCK_SIZE; i > 0; --i) {
+    scratch.resize(helpers::read_varint(in));
+    length = helpers::read_varint(in);
+    scratch.append(in, length);
+    in += length;
+  }
+  return scratch;
+}
+
+template <typename Metric>
+ResultList CompactBKTree<Metric>::find(std::string_view value, int limit) const {
+  ResultList output;
+  if (empty()) {
+    return output;
+  }
+  const auto prepared = m_metric.prepare(value);
+  std::string scratch;
+  std::vector<id_type> stack{0};
+  while (!stack.empty()) {
+    const id_type node = stack.back();
+    stack.pop_back();
+    const std::string_view word = _word(m_word_ids[node], scratch);
+    const int distance = prepared(word);
+    if (distance <= limit) {
+      output.emplace_back(word, distance);
+    }
+    // Children keyed within [distance - limit, distance + limit], pushed in
+    // reverse so that they are searched by ascending key, as BKTree::find does
+    auto first = m_keys.begin() + m_first_child[node];
+    auto last = m_keys.begin() + m_first_child[node + 1];
+    first = std::lower_bound(first, last, distance - limit);
+    last = std::upper_bound(first, last, distance + limit);
+    for (auto it = last; it != first; --it) {
+      stack.push_back(static_cast<id_type>(it - 1 - m_keys.begin()));
+    }
+  }
+  return output;
+}
+
+} // namespace bk_tree
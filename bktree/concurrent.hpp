@@ -0,0 +1,542 @@
+//
+// bk-tree   Header-only Burkhard-Keller tree library
+// Copyright (C) 2020-2023  John Law
+//
+// This file is part of bk-tree.
+//
+// bk-tree is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// bk-tree is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with bk-tree.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include "bktree.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <future>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+#ifndef BK_RECLAIM_THRESHOLD
+#define BK_RECLAIM_THRESHOLD 64
+#endif
+
+namespace bk_tree {
+
+namespace helpers {
+
+/**
+ * @brief Epoch-based reclamation for read-mostly data structures
+ *
+ * Readers announce themselves with pin() for the duration of a traversal. A
+ * writer unlinks objects, hands them to retire(), and frees them in reclaim()
+ * once every reader that could still observe them has left. Any thread may
+ * call retire(), even while pinned, since it only queues the object.
+ * synchronize() and reclaim() wait for the readers and must not be called
+ * while the calling thread itself holds a Guard.
+ */
+class EpochDomain {
+public:
+  class Guard {
+  public:
+    Guard(Guard &&other) noexcept
+        : m_counter(std::exchange(other.m_counter, nullptr)) {}
+    Guard(const Guard &) = delete;
+    Guard &operator=(const Guard &) = delete;
+    Guard &operator=(Guard &&) = delete;
+    ~Guard() {
+      if (m_counter != nullptr) {
+        m_counter->fetch_sub(1, std::memory_order_release);
+      }
+    }
+
+  private:
+    friend class EpochDomain;
+    explicit Guard(std::atomic<size_t> *counter) : m_counter(counter) {}
+
+    std::atomic<size_t> *m_counter;
+  };
+
+  EpochDomain() = default;
+  EpochDomain(const EpochDomain &) = delete;
+  EpochDomain &operator=(const EpochDomain &) = delete;
+  ~EpochDomain() { free_retired(m_retired); }
+
+  [[nodiscard]] Guard pin() const noexcept {
+    for (;;) {
+      const auto epoch = m_epoch.load();
+      auto &counter = m_readers[epoch & 1].count;
+      counter.fetch_add(1);
+      if (m_epoch.load() == epoch) {
+        return Guard(&counter);
+      }
+      counter.fetch_sub(1, std::memory_order_release);
+    }
+  }
+
+  template <typename T>
+  void retire(const T *object) {
+    std::lock_guard lock(m_retired_mutex);
+    m_retired.emplace_back(object,
+                           [](const void *p) { delete static_cast<const T *>(p); });
+  }
+
+  size_t retired() const {
+    std::lock_guard lock(m_retired_mutex);
+    return m_retired.size();
+  }
+
+  /**
+   * @brief Waits until every reader pinned before the call has left
+   */
+  void synchronize() const {
+    // One flip per grace period is only enough if grace periods do not overlap
+    std::lock_guard lock(m_synchronize_mutex);
+    const auto epoch = m_epoch.fetch_add(1);
+    while (m_readers[epoch & 1].count.load(std::memory_order_acquire) != 0) {
+      std::this_thread::yield();
+    }
+  }
+
+  void reclaim() {
+    retired_list retired;
+    {
+      std::lock_guard lock(m_retired_mutex);
+      retired.swap(m_retired);
+    }
+    if (retired.empty()) {
+      return;
+    }
+    synchronize();
+    free_retired(retired);
+  }
+
+private:
+  using retired_list = std::vector<std::pair<const void *, void (*)(const void *)>>;
+
+  static void free_retired(retired_list &retired) {
+    for (auto &[object, deleter] : retired) {
+      deleter(object);
+    }
+    retired.clear();
+  }
+
+  struct alignas(64) ReaderCount {
+    std::atomic<size_t> count = 0;
+  };
+
+  mutable std::atomic<std::uint64_t> m_epoch = 0;
+  mutable std::array<ReaderCount, 2> m_readers;
+  mutable std::mutex m_retired_mutex, m_synchronize_mutex;
+  retired_list m_retired;
+};
+
+} // namespace helpers
+
+/**
+ * @brief BK-tree whose readers run without locks alongside a writer
+ *
+ * Child lists are immutable once published: an insert copies the parent's
+ * list, adds the new child and swaps the copy in with a single atomic store, so
+ * a concurrent find sees either the old or the new list. Erase marks the node
+ * as deleted and unlinks it once it has no children left. Replaced lists and
+ * unlinked nodes are freed through an EpochDomain after every reader that might
+ * still hold them has finished.
+ *
+ * Inserts may also run concurrently with each other. A new child is published
+ * with a compare-and-swap on its parent's list, so two inserts only contend
+ * when they extend the same node, and the loser simply retries from that node.
+ * Erase takes an internal lock that excludes inserts, but never readers.
+ *
+ * An erased node that still has children stays in the tree as a tombstone
+ * that every query passing by must still evaluate. Once the tombstones reach
+ * the RebuildPolicy's share of the live words, erase starts rebuild() on a
+ * background thread: it builds a fresh tree from the live words and publishes
+ * it with one atomic store. Readers are never blocked; writers wait for it.
+ *
+ * Any number of threads may call find and insert concurrently, provided the
+ * metric is safe to share (all metrics in bk_tree::metrics are). Unlike BKTree,
+ * the tree holds each word at most once.
+ */
+template <typename Metric>
+class ConcurrentBKTree {
+  static_assert(helpers::is_metric<Metric>::value, "Metric must be of type Distance");
+
+  using metric_type = Metric;
+
+  struct Node;
+
+  struct Children {
+    std::vector<std::pair<int, Node *>> entries;
+
+    Node *find(int distance) const noexcept {
+      auto it = std::lower_bound(
+          entries.begin(), entries.end(), distance,
+          [](const std::pair<int, Node *> &entry, int d) { return entry.first < d; });
+      return it != entries.end() && it->first == distance ? it->second : nullptr;
+    }
+  };
+
+  struct Node {
+    explicit Node(std::string_view value) : word(value), sketch(value) {}
+    ~Node() { delete children.load(std::memory_order_relaxed); }
+
+    const std::string word;
+    const metrics::WordSketch sketch;
+    std::atomic<bool> erased = false;
+    std::atomic<const Children *> children = nullptr;
+  };
+
+public:
+  explicit ConcurrentBKTree(const metric_type &distance = Metric())
+      : m_metric(distance) {}
+
+  ConcurrentBKTree(std::initializer_list<std::string_view> list) : ConcurrentBKTree() {
+    for (auto &str : list) {
+      insert(str);
+    }
+  }
+
+  ConcurrentBKTree(const ConcurrentBKTree &) = delete;
+  ConcurrentBKTree &operator=(const ConcurrentBKTree &) = delete;
+
+  ~ConcurrentBKTree() {
+    if (m_rebuild.valid()) {
+      m_rebuild.wait();
+    }
+    destroy(m_root.load(std::memory_order_relaxed));
+  }
+
+  bool insert(std::string_view value);
+  bool erase(std::string_view value);
+  size_t size() const noexcept { return m_tree_size.load(std::memory_order_relaxed); }
+  bool empty() const noexcept { return size() == 0; }
+  [[nodiscard]] ResultList find(std::string_view value, int limit) const;
+
+  /**
+   * @brief Erased nodes still linked into the tree, per live word
+   */
+  double degradation() const noexcept {
+    const size_t words = size();
+    const size_t tombstones = m_tombstones.load(std::memory_order_relaxed);
+    return words == 0 ? 0.0 : static_cast<double>(tombstones) / words;
+  }
+  RebuildPolicy rebuild_policy() const {
+    std::shared_lock writer_lock(m_writer_mutex);
+    return m_policy;
+  }
+  void set_rebuild_policy(const RebuildPolicy &policy) {
+    std::unique_lock writer_lock(m_writer_mutex);
+    m_policy = policy;
+  }
+  void rebuild();
+
+private:
+  static void destroy(Node *node) {
+    if (node == nullptr) {
+      return;
+    }
+    if (auto *children = node->children.load(std::memory_order_relaxed)) {
+      for (auto &[_, child] : children->entries) {
+        destroy(child);
+      }
+    }
+    delete node;
+  }
+
+  static Children *with_child(const Children *children, int distance, Node *child);
+  void publish(Node *parent, const Children *old_children, Children *new_children);
+  void unlink(std::vector<Node *> &path);
+  void maybe_reclaim() {
+    if (m_domain.retired() >= BK_RECLAIM_THRESHOLD) {
+      m_domain.reclaim();
+    }
+  }
+
+  std::atomic<Node *> m_root = nullptr;
+  const metric_type m_metric;
+  std::atomic<size_t> m_tree_size = 0;
+  std::atomic<size_t> m_tombstones = 0;
+  helpers::EpochDomain m_domain;
+  // Shared by inserts, exclusive for erase and rebuild
+  mutable std::shared_mutex m_writer_mutex;
+  RebuildPolicy m_policy;
+  std::atomic<bool> m_rebuilding = false;
+  std::future<void> m_rebuild;
+};
+
+template <typename Metric>
+void ConcurrentBKTree<Metric>::publish(Node *parent, const Children *old_children,
+                                       Children *new_children) {
+  if (new_children->entries.empty()) {
+    delete new_children;
+    new_children = nullptr;
+  }
+  parent->children.store(new_children, std::memory_order_release);
+  if (old_children != nullptr) {
+    m_domain.retire(old_children);
+  }
+}
+
+template <typename Metric>
+auto ConcurrentBKTree<Metric>::with_child(const Children *children, int distance,
+                                          Node *child) -> Children * {
+  auto *copy = children != nullptr ? new Children(*children) : new Children();
+  auto it = std::lower_bound(
+      copy->entries.begin(), copy->entries.end(), distance,
+      [](const std::pair<int, Node *> &entry, int d) { return entry.first < d; });
+  copy->entries.insert(it, {distance, child});
+  return copy;
+}
+
+template <typename Metric>
+bool ConcurrentBKTree<Metric>::insert(std::string_view value) {
+  std::shared_lock writer_lock(m_writer_mutex);
+  std::unique_ptr<Node> fresh;
+  bool inserted = false;
+  {
+    // Other inserts may retire the lists this traversal is reading
+    const auto guard = m_domain.pin();
+    Node *node = m_root.load(std::memory_order_acquire);
+    while (node == nullptr) {
+      fresh = std::make_unique<Node>(value);
+      if (m_root.compare_exchange_strong(node, fresh.get(), std::memory_order_acq_rel,
+                                         std::memory_order_acquire)) {
+        fresh.release();
+        m_tree_size.fetch_add(1, std::memory_order_relaxed);
+        return true;
+      }
+    }
+    for (;;) {
+      const int distance = m_metric(value, node->word);
+      if (distance < 0) {
+        break;
+      }
+      if (distance == 0 && node->word == value) {
+        bool erased = true;
+        inserted = node->erased.compare_exchange_strong(erased, false,
+                                                        std::memory_order_acq_rel);
+        if (inserted) {
+          m_tombstones.fetch_sub(1, std::memory_order_relaxed);
+        }
+        break;
+      }
+      const Children *children = node->children.load(std::memory_order_acquire);
+      if (Node *child = children != nullptr ? children->find(distance) : nullptr) {
+        node = child;
+        continue;
+      }
+      if (fresh == nullptr) {
+        fresh = std::make_unique<Node>(value);
+      }
+      Children *copy = with_child(children, distance, fresh.get());
+      if (node->children.compare_exchange_strong(children, copy,
+                                                 std::memory_order_acq_rel,
+                                                 std::memory_order_acquire)) {
+        fresh.release();
+        if (children != nullptr) {
+          m_domain.retire(children);
+        }
+        inserted = true;
+        break;
+      }
+      // Another insert extended this node first; look at its new children
+      delete copy;
+    }
+  }
+  if (inserted) {
+    m_tree_size.fetch_add(1, std::memory_order_relaxed);
+    maybe_reclaim();
+  }
+  return inserted;
+}
+
+template <typename Metric>
+bool ConcurrentBKTree<Metric>::erase(std::string_view value) {
+  std::unique_lock writer_lock(m_writer_mutex);
+  std::vector<Node *> path;
+  Node *node = m_root.load(std::memory_order_relaxed);
+  while (node != nullptr) {
+    path.push_back(node);
+    const int distance = m_metric(value, node->word);
+    if (distance < 0) {
+      return false;
+    }
+    if (distance == 0 && node->word == value) {
+      if (node->erased.load(std::memory_order_relaxed)) {
+        return false;
+      }
+      node->erased.store(true, std::memory_order_release);
+      m_tree_size.fetch_sub(1, std::memory_order_relaxed);
+      m_tombstones.fetch_add(1, std::memory_order_relaxed);
+      unlink(path);
+      maybe_reclaim();
+      if (m_policy.due(degradation(), size()) && !m_rebuilding.exchange(true)) {
+        m_rebuild = std::async(std::launch::async, [this] {
+          rebuild();
+          m_rebuilding.store(false);
+        });
+      }
+      return true;
+    }
+    const Children *children = node->children.load(std::memory_order_relaxed);
+    node = children != nullptr ? children->find(distance) : nullptr;
+  }
+  return false;
+}
+
+/**
+ * @brief Unlinks erased leaves at the end of `path`, walking up as far as possible
+ */
+template <typename Metric>
+void ConcurrentBKTree<Metric>::unlink(std::vector<Node *> &path) {
+  while (!path.empty()) {
+    Node *leaf = path.back();
+    if (!leaf->erased.load(std::memory_order_relaxed) ||
+        leaf->children.load(std::memory_order_relaxed) != nullptr) {
+      return;
+    }
+    path.pop_back();
+    if (path.empty()) {
+      m_root.store(nullptr, std::memory_order_release);
+    } else {
+      Node *parent = path.back();
+      const Children *children = parent->children.load(std::memory_order_relaxed);
+      auto *copy = new Children();
+      copy->entries.reserve(children->entries.size() - 1);
+      for (auto const &entry : children->entries) {
+        if (entry.second != leaf) {
+          copy->entries.push_back(entry);
+        }
+      }
+      publish(parent, children, copy);
+    }
+    m_domain.retire(leaf);
+    m_tombstones.fetch_sub(1, std::memory_order_relaxed);
+  }
+}
+
+/**
+ * @brief Replaces the tree with a fresh build of its live words
+ *
+ * The new nodes are linked privately, in a shuffled order, and published with
+ * a single store of the root; finds that already started finish on the old
+ * nodes, which are then reclaimed. Inserts and erases wait until it is done.
+ */
+template <typename Metric>
+void ConcurrentBKTree<Metric>::rebuild() {
+  std::vector<Node *> nodes;
+  {
+    std::unique_lock writer_lock(m_writer_mutex);
+    if (Node *root = m_root.load(std::memory_order_relaxed)) {
+      nodes.push_back(root);
+    }
+    std::vector<std::string_view> words;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+      if (auto *children = nodes[i]->children.load(std::memory_order_relaxed)) {
+        for (auto const &[_, child] : children->entries) {
+          nodes.push_back(child);
+        }
+      }
+      if (!nodes[i]->erased.load(std::memory_order_relaxed)) {
+        words.push_back(nodes[i]->word);
+      }
+    }
+    std::shuffle(words.begin(), words.end(), std::mt19937(words.size()));
+
+    Node *root = nullptr;
+    size_t count = 0;
+    for (auto word : words) {
+      auto fresh = std::make_unique<Node>(word);
+      Node *node = root;
+      while (node != nullptr) {
+        const int distance = m_metric(word, node->word);
+        if (distance < 0) {
+          break;
+        }
+        const Children *children = node->children.load(std::memory_order_relaxed);
+        if (Node *child = children != nullptr ? children->find(distance) : nullptr) {
+          node = child;
+          continue;
+        }
+        node->children.store(with_child(children, distance, fresh.release()),
+                             std::memory_order_relaxed);
+        delete children;
+        ++count;
+        break;
+      }
+      if (root == nullptr) {
+        root = fresh.release();
+        ++count;
+      }
+    }
+    m_root.store(root, std::memory_order_release);
+    m_tree_size.store(count, std::memory_order_relaxed);
+    m_tombstones.store(0, std::memory_order_relaxed);
+    for (Node *node : nodes) {
+      m_domain.retire(node);
+    }
+  }
+  m_domain.reclaim();
+}
+
+template <typename Metric>
+ResultList ConcurrentBKTree<Metric>::find(std::string_view value, int limit) const {
+  ResultList output;
+  const auto guard = m_domain.pin();
+  const metrics::WordSketch sketch(value);
+  const auto prepared = m_metric.prepare(value);
+  std::vector<const Node *> stack;
+  if (const Node *root = m_root.load(std::memory_order_acquire)) {
+    stack.push_back(root);
+  }
+  while (!stack.empty()) {
+    const Node *node = stack.back();
+    stack.pop_back();
+    const Children *children = node->children.load(std::memory_order_acquire);
+    if constexpr (helpers::has_bounds<Metric>) {
+      const int lower = m_metric.lower_bound(sketch, node->sketch);
+      if (lower > limit) {
+        if (children == nullptr) {
+          continue;
+        }
+        const int upper = m_metric.upper_bound(sketch, node->sketch);
+        auto it = std::lower_bound(
+            children->entries.begin(), children->entries.end(), lower - limit,
+            [](const std::pair<int, Node *> &entry, int d) { return entry.first < d; });
+        if (it == children->entries.end() || it->first > upper + limit) {
+          continue;
+        }
+      }
+    }
+    const int distance = prepared(node->word);
+    if (distance <= limit && !node->erased.load(std::memory_order_acquire)) {
+      output.push_back({node->word, distance});
+    }
+    if (children != nullptr) {
+      for (auto it = children->entries.rbegin(); it != children->entries.rend(); ++it) {
+        if (std::abs(it->first - distance) <= limit) {
+          stack.push_back(it->second);
+        }
+      }
+    }
+  }
+  return output;
+}
+
+} // namespace bk_tree
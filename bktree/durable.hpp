@@ -0,0 +1,433 @@
+//
+// bk-tree   Header-only Burkhard-Keller tree library
+// Copyright (C) 2020-2023  John Law
+//
+// This file is part of bk-tree.
+//
+// bk-tree is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// bk-tree is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with bk-tree.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include "bktree.hpp"
+
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <system_error>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifndef BK_WAL_CHECKPOINT_BYTES
+#define BK_WAL_CHECKPOINT_BYTES (64 << 20)
+#endif
+
+namespace bk_tree {
+
+namespace helpers {
+
+[[noreturn]] inline void throw_errno(const std::string &what) {
+  throw std::system_error(errno, std::generic_category(), what);
+}
+
+/**
+ * @brief 32-bit FNV-1a hash, used to detect torn or corrupt log records
+ */
+inline std::uint32_t checksum(std::string_view bytes) noexcept {
+  std::uint32_t hash = 2166136261u;
+  for (unsigned char c : bytes) {
+    hash = (hash ^ c) * 16777619u;
+  }
+  return hash;
+}
+
+/**
+ * @brief Owning POSIX file descriptor
+ */
+class FileHandle {
+public:
+  FileHandle() = default;
+  FileHandle(const std::filesystem::path &path, int flags)
+      : m_fd(::open(path.c_str(), flags | O_CLOEXEC, 0644)) {
+    if (m_fd < 0) {
+      throw_errno(path.string());
+    }
+  }
+
+  FileHandle(FileHandle &&other) noexcept : m_fd(std::exchange(other.m_fd, -1)) {}
+  FileHandle &operator=(FileHandle &&other) noexcept {
+    std::swap(m_fd, other.m_fd);
+    return *this;
+  }
+
+  ~FileHandle() {
+    if (m_fd >= 0) {
+      ::close(m_fd);
+    }
+  }
+
+  void write_all(std::string_view bytes) const {
+    while (!bytes.empty()) {
+      const ssize_t written = ::write(m_fd, bytes.data(), bytes.size());
+      if (written < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        throw_errno("write");
+      }
+      bytes.remove_prefix(static_cast<size_t>(written));
+    }
+  }
+
+  void sync() const {
+    if (::fsync(m_fd) != 0) {
+      throw_errno("fsync");
+    }
+  }
+
+private:
+  int m_fd = -1;
+};
+
+/**
+ * @brief Makes renames within `directory` durable
+ */
+inline void sync_directory(const std::filesystem::path &directory) {
+  FileHandle(directory, O_RDONLY | O_DIRECTORY).sync();
+}
+
+} // namespace helpers
+
+/**
+ * @brief BKTree whose updates survive restarts
+ *
+ * Every successful insert or erase is appended to a write-ahead log in
+ * `directory` and made durable before the call returns. Concurrent writers
+ * share fsyncs: whichever writer finds no flush in progress writes and syncs
+ * everything queued so far on behalf of all of them (group commit).
+ *
+ * checkpoint() writes a snapshot of the tree's structure and starts a new,
+ * empty log; it also runs automatically once the log reaches
+ * `checkpoint_bytes`. On construction the latest snapshot is loaded, which
+ * costs no metric evaluations, and only the log written since is replayed, so
+ * recovery work beyond reading the snapshot is bounded by the log size. A torn
+ * record at the end of the log is discarded.
+ *
+ * Files: `snapshot` holds "BKCP", the id of the log it precedes, the offset in
+ * that log it covers, then BKTree::serialize. `log` holds "BKWL" and its id,
+ * then records of (8-bit op, 32-bit length, bytes, 32-bit checksum). All
+ * integers are in native byte order.
+ */
+template <typename Metric>
+class DurableBKTree {
+  using metric_type = Metric;
+  using tree_type = BKTree<metric_type>;
+
+public:
+  explicit DurableBKTree(std::filesystem::path directory,
+                         const metric_type &distance = Metric(),
+                         size_t checkpoint_bytes = BK_WAL_CHECKPOINT_BYTES);
+
+  DurableBKTree(const DurableBKTree &) = delete;
+  DurableBKTree &operator=(const DurableBKTree &) = delete;
+
+  bool insert(std::string_view value) { return apply(Op::insert, value); }
+  bool erase(std::string_view value) { return apply(Op::erase, value); }
+  [[nodiscard]] ResultList find(std::string_view value, int limit) const {
+    std::shared_lock lock(m_tree_mutex);
+    return m_tree.find(value, limit);
+  }
+
+  size_t size() const {
+    std::shared_lock lock(m_tree_mutex);
+    return m_tree.size();
+  }
+  bool empty() const { return size() == 0; }
+
+  void checkpoint() {
+    std::lock_guard lock(m_checkpoint_mutex);
+    checkpoint_locked();
+  }
+
+  /**
+   * @brief Replaces the whole tree, e.g. with a freshly loaded dictionary, and
+   * checkpoints it
+   */
+  void reset(tree_type tree) {
+    std::lock_guard lock(m_checkpoint_mutex);
+    {
+      std::unique_lock tree_lock(m_tree_mutex);
+      m_tree = std::move(tree);
+    }
+    checkpoint_locked();
+  }
+
+  size_t log_bytes() const {
+    std::lock_guard lock(m_log_mutex);
+    return m_log_size;
+  }
+  size_t replayed() const noexcept { return m_replayed; }
+
+private:
+  enum class Op : std::uint8_t { insert = 1, erase = 2 };
+
+  static constexpr std::string_view log_magic = "BKWL";
+  static constexpr std::string_view snapshot_magic = "BKCP";
+  static constexpr size_t log_header_size = 4 + sizeof(std::uint64_t);
+
+  bool apply(Op op, std::string_view value);
+  void commit(std::uint64_t sequence);
+  void checkpoint_locked();
+  size_t replay(std::string_view log, size_t offset);
+  void create_log(std::uint64_t id);
+
+  static void encode(std::string &out, Op op, std::string_view value) {
+    const size_t begin = out.size();
+    out.push_back(static_cast<char>(op));
+    const auto length = static_cast<std::uint32_t>(value.size());
+    out.append(reinterpret_cast<const char *>(&length), sizeof(length));
+    out.append(value);
+    const auto sum = helpers::checksum(std::string_view(out).substr(begin));
+    out.append(reinterpret_cast<const char *>(&sum), sizeof(sum));
+  }
+
+  const std::filesystem::path m_directory;
+  const size_t m_checkpoint_bytes;
+  tree_type m_tree;
+  mutable std::shared_mutex m_tree_mutex;
+  std::mutex m_checkpoint_mutex;
+  size_t m_replayed = 0;
+
+  // Log state, guarded by m_log_mutex; m_log itself is written by the flushing
+  // writer without the mutex, and replaced only while nothing is in flight
+  mutable std::mutex m_log_mutex;
+  std::condition_variable m_flushed;
+  helpers::FileHandle m_log;
+  std::uint64_t m_log_id = 0;
+  size_t m_log_size = 0;
+  std::string m_pending;
+  std::uint64_t m_appended = 0, m_durable = 0;
+  bool m_flushing = false;
+  std::exception_ptr m_failure;
+};
+
+template <typename Metric>
+DurableBKTree<Metric>::DurableBKTree(std::filesystem::path directory,
+                                     const metric_type &distance,
+                                     size_t checkpoint_bytes)
+    : m_directory(std::move(directory)), m_checkpoint_bytes(checkpoint_bytes),
+      m_tree(distance) {
+  std::filesystem::create_directories(m_directory);
+  // The snapshot covers its log up to `covered`; with no snapshot, log 1 is
+  // replayed from its start
+  std::uint64_t snapshot_log = 0, covered = 0;
+  if (std::ifstream in{m_directory / "snapshot", std::ios::binary}) {
+    char magic[snapshot_magic.size()];
+    if (!in.read(magic, sizeof(magic)) ||
+        std::string_view(magic, sizeof(magic)) != snapshot_magic) {
+      throw std::runtime_error("bk_tree: not a snapshot");
+    }
+    snapshot_log = helpers::read_raw<std::uint64_t>(in);
+    covered = helpers::read_raw<std::uint64_t>(in);
+    m_tree = tree_type::deserialize(in, distance);
+  }
+
+  std::string log;
+  if (std::ifstream in{m_directory / "log", std::ios::binary}) {
+    log.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  }
+  if (log.size() < log_header_size || !log.starts_with(log_magic)) {
+    // Missing, or torn while being created by a checkpoint
+    create_log(snapshot_log + 1);
+    return;
+  }
+  std::memcpy(&m_log_id, log.data() + log_magic.size(), sizeof(m_log_id));
+  size_t begin = log_header_size;
+  if (m_log_id == snapshot_log) {
+    // Crashed between writing a snapshot and starting the next log
+    begin = std::max<size_t>(begin, covered);
+  } else if (m_log_id != snapshot_log + 1) {
+    throw std::runtime_error("bk_tree: log does not follow the snapshot");
+  }
+  m_log_size = replay(log, std::min(begin, log.size()));
+  if (m_log_size < log.size()) {
+    std::filesystem::resize_file(m_directory / "log", m_log_size);
+  }
+  m_log = helpers::FileHandle(m_directory / "log", O_WRONLY | O_APPEND);
+}
+
+/**
+ * @brief Applies the valid records of `log` from `offset` on
+ *
+ * @return the offset just past the last valid record
+ */
+template <typename Metric>
+size_t DurableBKTree<Metric>::replay(std::string_view log, size_t offset) {
+  constexpr size_t overhead = 1 + 2 * sizeof(std::uint32_t);
+  while (log.size() - offset >= overhead) {
+    std::uint32_t length, sum;
+    std::memcpy(&length, log.data() + offset + 1, sizeof(length));
+    if (log.size() - offset - overhead < length) {
+      break;
+    }
+    const auto record = log.substr(offset, 1 + sizeof(length) + length);
+    std::memcpy(&sum, log.data() + offset + record.size(), sizeof(sum));
+    if (sum != helpers::checksum(record)) {
+      break;
+    }
+    const auto value = record.substr(1 + sizeof(length));
+    switch (static_cast<Op>(record.front())) {
+    case Op::insert:
+      m_tree.insert(value);
+      break;
+    case Op::erase:
+      m_tree.erase(value);
+      break;
+    default:
+      return offset;
+    }
+    ++m_replayed;
+    offset += record.size() + sizeof(sum);
+  }
+  return offset;
+}
+
+/**
+ * @brief Starts log `id` by atomically replacing the current log
+ */
+template <typename Metric>
+void DurableBKTree<Metric>::create_log(std::uint64_t id) {
+  const auto temporary = m_directory / "log.tmp";
+  {
+    helpers::FileHandle file(temporary, O_WRONLY | O_CREAT | O_TRUNC);
+    std::string header(log_magic);
+    header.append(reinterpret_cast<const char *>(&id), sizeof(id));
+    file.write_all(header);
+    file.sync();
+  }
+  std::filesystem::rename(temporary, m_directory / "log");
+  helpers::sync_directory(m_directory);
+  m_log = helpers::FileHandle(m_directory / "log", O_WRONLY | O_APPEND);
+  m_log_id = id;
+  m_log_size = log_header_size;
+}
+
+template <typename Metric>
+bool DurableBKTree<Metric>::apply(Op op, std::string_view value) {
+  std::uint64_t sequence;
+  {
+    std::unique_lock tree_lock(m_tree_mutex);
+    // Held across the update, so that no failure is recorded between the check
+    // and the append
+    std::lock_guard lock(m_log_mutex);
+    if (m_failure) {
+      std::rethrow_exception(m_failure);
+    }
+    if (!(op == Op::insert ? m_tree.insert(value) : m_tree.erase(value))) {
+      return false;
+    }
+    encode(m_pending, op, value);
+    sequence = ++m_appended;
+  }
+  commit(sequence);
+  if (m_checkpoint_bytes > 0 && log_bytes() >= m_checkpoint_bytes) {
+    // One automatic checkpoint at a time; other writers carry on
+    if (std::unique_lock lock(m_checkpoint_mutex, std::try_to_lock); lock) {
+      checkpoint_locked();
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Returns once record `sequence` is durable, flushing if no one else is
+ */
+template <typename Metric>
+void DurableBKTree<Metric>::commit(std::uint64_t sequence) {
+  std::unique_lock lock(m_log_mutex);
+  while (m_durable < sequence) {
+    if (m_failure) {
+      std::rethrow_exception(m_failure);
+    }
+    if (m_flushing) {
+      m_flushed.wait(lock);
+      continue;
+    }
+    m_flushing = true;
+    std::string batch;
+    batch.swap(m_pending);
+    const std::uint64_t last = m_appended;
+    lock.unlock();
+    std::exception_ptr failure;
+    try {
+      m_log.write_all(batch);
+      m_log.sync();
+    } catch (...) {
+      failure = std::current_exception();
+    }
+    lock.lock();
+    m_flushing = false;
+    if (failure) {
+      // The log no longer matches the tree; apply refuses further updates
+      m_failure = failure;
+    } else {
+      m_durable = last;
+      m_log_size += batch.size();
+    }
+    m_flushed.notify_all();
+  }
+}
+
+template <typename Metric>
+void DurableBKTree<Metric>::checkpoint_locked() {
+  // Blocks writers but not finds
+  std::shared_lock tree_lock(m_tree_mutex);
+  std::uint64_t appended, log_id, covered;
+  {
+    std::lock_guard lock(m_log_mutex);
+    appended = m_appended;
+  }
+  commit(appended);
+  {
+    std::lock_guard lock(m_log_mutex);
+    log_id = m_log_id;
+    covered = m_log_size;
+  }
+  const auto temporary = m_directory / "snapshot.tmp";
+  {
+    std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+    out.write(snapshot_magic.data(), snapshot_magic.size());
+    helpers::write_raw(out, log_id);
+    helpers::write_raw(out, covered);
+    m_tree.serialize(out);
+    if (!out.flush()) {
+      throw std::runtime_error("bk_tree: cannot write snapshot");
+    }
+  }
+  helpers::FileHandle(temporary, O_RDONLY).sync();
+  std::filesystem::rename(temporary, m_directory / "snapshot");
+  helpers::sync_directory(m_directory);
+  std::lock_guard lock(m_log_mutex);
+  create_log(log_id + 1);
+}
+
+} // namespace bk_tree
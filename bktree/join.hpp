@@ -0,0 +1,219 @@
+//
+// bk-tree   Header-only Burkhard-Keller tree library
+// Copyright (C) 2020-2023  John Law
+//
+// This file is part of bk-tree.
+//
+// bk-tree is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// bk-tree is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with bk-tree.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include "bktree.hpp"
+
+#ifndef BK_JOIN_BATCH_SIZE
+#define BK_JOIN_BATCH_SIZE 256
+#endif
+
+namespace bk_tree {
+
+namespace helpers {
+
+/**
+ * @brief Traversals behind similarity_join and self_join
+ *
+ * Every word below the child of a node keyed `i` lies at distance `i` from
+ * the node. A self join uses this twice. A word is paired with the words below
+ * it at the keys of its children, without evaluating the metric. Below each
+ * ancestor, reached through the child keyed `i`, it searches only the
+ * children keyed `i + 1` to `i + limit`: they are the ones that can hold a
+ * match and follow it in preorder, so every pair is found once, by the first
+ * of its words in preorder.
+ */
+template <typename Metric, typename Callback>
+class TreeJoin {
+  using node_type = BKTreeNode<Metric>;
+  using tree_type = BKTree<Metric>;
+  // Ancestors of a node, each with the key of its child towards the node
+  using path_type = std::vector<std::pair<const node_type *, int>>;
+
+  /**
+   * @brief Output list of BKTreeNode::_find that reports each match of `word`
+   */
+  struct Emitter {
+    Callback &emit;
+    std::string_view word;
+
+    void emplace_back(std::string_view other, int distance) {
+      emit(word, other, distance);
+    }
+  };
+
+public:
+  TreeJoin(const tree_type &tree, int limit, Callback &emit)
+      : m_tree(tree), m_limit(limit), m_emit(emit) {}
+
+  /**
+   * @brief Searches `b` for the words of `a` in batches of BK_JOIN_BATCH_SIZE
+   * consecutive words in preorder, which lie close together in `a`
+   */
+  void join(const tree_type &a, const tree_type &b, size_t thread_count) {
+    if (a.empty() || b.empty() || m_limit < 0) {
+      return;
+    }
+    std::vector<std::string_view> words;
+    words.reserve(a.size());
+    std::ranges::copy(a.words(), std::back_inserter(words));
+    const size_t batches = (words.size() + BK_JOIN_BATCH_SIZE - 1) / BK_JOIN_BATCH_SIZE;
+    _in_parallel(thread_count, batches, [&](size_t i) {
+      auto batch = std::span(words).subspan(i * BK_JOIN_BATCH_SIZE);
+      batch = batch.first(std::min<size_t>(batch.size(), BK_JOIN_BATCH_SIZE));
+      auto results = b.find_batch(batch, m_limit);
+      for (size_t j = 0; j < batch.size(); ++j) {
+        for (auto const &[word, distance] : results[j]) {
+          m_emit(batch[j], word, distance);
+        }
+      }
+    });
+  }
+
+  /**
+   * @brief Pairs the words of `tree` among themselves
+   *
+   * As in BKTree::parallel_for_each, the calling thread handles the top levels
+   * until they leave BK_PARALLEL_SUBTREES subtrees per thread.
+   */
+  void self(const tree_type &tree, size_t thread_count) {
+    if (tree.m_root == nullptr || m_limit < 0) {
+      return;
+    }
+    std::vector<std::pair<const node_type *, path_type>> subtrees, level;
+    subtrees.emplace_back(tree.m_root.get(), path_type{});
+    while (thread_count > 1 && subtrees.size() < thread_count * BK_PARALLEL_SUBTREES) {
+      level.clear();
+      for (auto &[node, path] : subtrees) {
+        _pair_node(node, path);
+        for (auto const &[key, child] : node->m_children) {
+          level.emplace_back(child.get(), path).second.emplace_back(node, key);
+        }
+      }
+      if (level.empty()) {
+        return;
+      }
+      std::swap(subtrees, level);
+    }
+    _in_parallel(thread_count, subtrees.size(), [&](size_t i) {
+      _pair_subtree(subtrees[i].first, subtrees[i].second);
+    });
+  }
+
+private:
+  // Runs task(i) for every i below `count` on up to `thread_count` threads
+  template <typename Task>
+  static void _in_parallel(size_t thread_count, size_t count, Task &&task) {
+    std::atomic<size_t> next = 0;
+    std::atomic<bool> failed = false;
+    tree_type::_in_parallel(std::clamp<size_t>(thread_count, 1, count), [&](size_t) {
+      try {
+        for (size_t i = next.fetch_add(1); i < count && !failed.load();
+             i = next.fetch_add(1)) {
+          task(i);
+        }
+      } catch (...) {
+        failed.store(true);
+        throw;
+      }
+    });
+  }
+
+  void _pair_subtree(const node_type *node, path_type &path) {
+    _pair_node(node, path);
+    for (auto const &[key, child] : node->m_children) {
+      path.emplace_back(node, key);
+      _pair_subtree(child.get(), path);
+      path.pop_back();
+    }
+  }
+
+  // Reports the pairs of `node` with the words after it in preorder
+  void _pair_node(const node_type *node, const path_type &path) {
+    const std::string_view word = node->m_word;
+    for (auto const &[key, child] : node->m_children) {
+      if (key > m_limit) {
+        break;
+      }
+      for (auto other :
+           typename tree_type::template WordView<Traversal::depth_first>(child.get())) {
+        m_emit(word, other, key);
+      }
+    }
+    if (path.empty()) {
+      return;
+    }
+    // Searched like find, sketch and pivot bounds included
+    std::vector<int> pivots(m_tree.pivot_count());
+    const auto query = m_tree._query(word, pivots);
+    Emitter output{m_emit, word};
+    for (auto const &[ancestor, key] : path) {
+      auto const &children = ancestor->m_children;
+      auto last = children.upper_bound(key + m_limit);
+      for (auto it = children.upper_bound(key); it != last; ++it) {
+        it->second->_find(output, query, m_limit, m_tree.m_metric);
+      }
+    }
+    m_tree._count_skips(query);
+  }
+
+  const tree_type &m_tree;
+  const int m_limit;
+  Callback &m_emit;
+};
+
+} // namespace helpers
+
+/**
+ * @brief Calls `fn(s, t, distance)` for every pair of a word `s` of `a` and a
+ * word `t` of `b` at most `limit` apart
+ *
+ * The words of `a` descend `b` in batches (see BKTree::find_batch), spread
+ * over `thread_count` threads. `fn` is called concurrently, in no particular
+ * order, and neither tree may be modified meanwhile. Distances are measured
+ * with the metric of `b`.
+ */
+template <typename Metric, typename Callback>
+requires std::invocable<Callback &, std::string_view, std::string_view, int>
+void similarity_join(const BKTree<Metric> &a, const BKTree<Metric> &b, int limit,
+                     Callback fn,
+                     size_t thread_count = std::thread::hardware_concurrency()) {
+  helpers::TreeJoin<Metric, Callback>(b, limit, fn).join(a, b, thread_count);
+}
+
+/**
+ * @brief Calls `fn(s, t, distance)` once for every pair of words of `tree`
+ * at most `limit` apart
+ *
+ * Pairs are those of distinct nodes, so duplicate words pair with each other
+ * at distance 0; `s` precedes `t` in the tree's preorder. Unlike a find for
+ * every word, no pair is searched for twice and distances implied by the
+ * tree's keys are not evaluated (see helpers::TreeJoin). Threading is as in
+ * similarity_join.
+ */
+template <typename Metric, typename Callback>
+requires std::invocable<Callback &, std::string_view, std::string_view, int>
+void self_join(const BKTree<Metric> &tree, int limit, Callback fn,
+               size_t thread_count = std::thread::hardware_concurrency()) {
+  helpers::TreeJoin<Metric, Callback>(tree, limit, fn).self(tree, thread_count);
+}
+
+} // namespace bk_tree
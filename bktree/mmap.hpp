@@ -0,0 +1,117 @@
+//
+// bk-tree   Header-only Burkhard-Keller tree library
+// Copyright (C) 2020-2023  John Law
+//
+// This file is part of bk-tree.
+//
+// bk-tree is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// bk-tree is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with bk-tree.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include "bktree.hpp"
+
+#include <cerrno>
+#include <string>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace bk_tree {
+
+namespace helpers {
+
+/**
+ * @brief Read-only, private memory mapping of a whole file (POSIX)
+ */
+class MappedFile {
+public:
+  explicit MappedFile(const std::string &path) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      throw std::system_error(errno, std::generic_category(), path);
+    }
+    struct stat info;
+    if (::fstat(fd, &info) != 0) {
+      const int error = errno;
+      ::close(fd);
+      throw std::system_error(error, std::generic_category(), path);
+    }
+    m_size = static_cast<size_t>(info.st_size);
+    if (m_size > 0) {
+      void *data = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data == MAP_FAILED) {
+        const int error = errno;
+        ::close(fd);
+        throw std::system_error(error, std::generic_category(), path);
+      }
+      m_data = static_cast<const char *>(data);
+    }
+    ::close(fd);
+  }
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  ~MappedFile() {
+    if (m_data != nullptr) {
+      ::munmap(const_cast<char *>(m_data), m_size);
+    }
+  }
+
+  std::string_view view() const noexcept { return {m_data, m_size}; }
+
+private:
+  const char *m_data = nullptr;
+  size_t m_size = 0;
+};
+
+} // namespace helpers
+
+/**
+ * @brief Builds a BKTree from a newline-delimited dictionary file
+ *
+ * The file is memory-mapped and every node views its word inside the mapping,
+ * which the tree keeps alive; no word is copied. Empty lines are skipped and a
+ * trailing `'\r'` is dropped. `thread_count > 1` selects the parallel build of
+ * BKTree::insert_views. Throws `std::system_error` if the file cannot be
+ * mapped.
+ */
+template <typename Metric>
+BKTree<Metric> load_dictionary(const std::string &path, size_t thread_count = 1,
+                               const Metric &metric = Metric()) {
+  auto file = std::make_shared<const helpers::MappedFile>(path);
+  std::string_view rest = file->view();
+  std::vector<std::string_view> words;
+  words.reserve(std::count(rest.begin(), rest.end(), '\n') + 1);
+  while (!rest.empty()) {
+    const size_t end = std::min(rest.find('\n'), rest.size());
+    std::string_view line = rest.substr(0, end);
+    rest.remove_prefix(std::min(end + 1, rest.size()));
+    if (line.ends_with('\r')) {
+      line.remove_suffix(1);
+    }
+    if (!line.empty()) {
+      words.push_back(line);
+    }
+  }
+  BKTree<Metric> tree(metric);
+  tree.insert_views(words, std::move(file), thread_count);
+  return tree;
+}
+
+} // namespace bk_tree
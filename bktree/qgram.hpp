@@ -0,0 +1,230 @@
+//
+// bk-tree   Header-only Burkhard-Keller tree library
+// Copyright (C) 2020-2023  John Law
+//
+// This file is part of bk-tree.
+//
+// bk-tree is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// bk-tree is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with bk-tree.  If not, see <https://www.gnu.org/licenses/>.
+//
+
+#pragma once
+
+#include "bktree.hpp"
+
+#include <type_traits>
+#include <unordered_map>
+
+#ifndef BK_QGRAM_LENGTH
+#define BK_QGRAM_LENGTH 2
+#endif
+
+namespace bk_tree {
+
+namespace helpers {
+
+/**
+ * @brief How many q-grams a single unit of distance can destroy, or 0 when
+ * count filtering does not apply to the metric
+ */
+template <typename Metric>
+constexpr size_t grams_per_unit(size_t q) noexcept {
+  if constexpr (std::is_same_v<Metric, metrics::EditDistance> ||
+                std::is_same_v<Metric, metrics::HammingDistance>) {
+    return q;
+  } else if constexpr (std::is_same_v<Metric, metrics::DamerauLevenshteinDistance>) {
+    // A transposition touches two adjacent characters
+    return q + 1;
+  } else {
+    return 0;
+  }
+}
+
+} // namespace helpers
+
+/**
+ * @brief Inverted q-gram index answering the same queries as BKTree::find
+ *
+ * Each word is padded with Q - 1 sentinels on both sides and split into its
+ * |w| + Q - 1 overlapping q-grams. Words within distance k of a query share at
+ * least max(|s|, |t|) + Q - 1 - k * helpers::grams_per_unit<Metric>(Q) of them,
+ * so a query counts the shared q-grams along its posting lists and only
+ * evaluates the metric on words that reach the count and whose length is within
+ * k. Where the bound drops to zero, as it does for large radii and short words,
+ * every word of that length is evaluated.
+ *
+ * Unlike BKTree, the cost of a query depends on the lengths of its posting
+ * lists rather than on how well the radius prunes the tree, which pays off
+ * at edit radius 3 and above. The index only grows; it holds words as a
+ * multiset, like BKTree.
+ */
+template <typename Metric, size_t Q = BK_QGRAM_LENGTH>
+class QGramIndex {
+  static_assert(helpers::is_metric<Metric>::value, "Metric must be of type Distance");
+  static_assert(Q >= 1 && Q <= 4, "q-grams are packed into 32 bits");
+  static_assert(helpers::grams_per_unit<Metric>(Q) > 0,
+                "Count filtering needs EditDistance, DamerauLevenshteinDistance or "
+                "HammingDistance");
+
+  using metric_type = Metric;
+  using gram_type = std::uint32_t;
+  using id_type = std::uint32_t;
+  // Pairs of (q-gram, occurrences), by ascending q-gram
+  using gram_list = std::vector<std::pair<gram_type, id_type>>;
+
+public:
+  explicit QGramIndex(const metric_type &distance = Metric()) : m_metric(distance) {}
+
+  QGramIndex(std::initializer_list<std::string_view> list) : QGramIndex() {
+    for (auto &str : list) {
+      insert(str);
+    }
+  }
+
+  bool insert(std::string_view value);
+  size_t size() const noexcept { return m_words.size(); }
+  bool empty() const noexcept { return m_words.empty(); }
+  [[nodiscard]] ResultList find(std::string_view value, int limit) const;
+
+private:
+  static void grams(std::string_view value, gram_list &output);
+
+  const metric_type m_metric;
+  std::vector<std::string> m_words;
+  // Ids of the words of each length
+  std::vector<std::vector<id_type>> m_lengths;
+  // Pairs of (word id, occurrences) for each q-gram, by ascending id
+  std::unordered_map<gram_type, std::vector<std::pair<id_type, id_type>>> m_postings;
+};
+
+template <typename Metric, size_t Q>
+void QGramIndex<Metric, Q>::grams(std::string_view value, gram_list &output) {
+  // Sentinels 0 before and 1 after the word; a byte that collides with them
+  // only adds candidates
+  constexpr gram_type mask = Q == 4 ? ~gram_type{0} : (gram_type{1} << (8 * Q)) - 1;
+  std::vector<gram_type> all;
+  all.reserve(value.size() + Q - 1);
+  gram_type gram = 0;
+  for (size_t i = 0; i < value.size() + 2 * (Q - 1); ++i) {
+    gram_type c = 1;
+    if (i < Q - 1) {
+      c = 0;
+    } else if (i - (Q - 1) < value.size()) {
+      c = static_cast<unsigned char>(value[i - (Q - 1)]);
+    }
+    gram = ((gram << 8) | c) & mask;
+    if (i + 1 >= Q) {
+      all.push_back(gram);
+    }
+  }
+  std::sort(all.begin(), all.end());
+  output.clear();
+  for (gram_type g : all) {
+    if (output.empty() || output.back().first != g) {
+      output.emplace_back(g, 0);
+    }
+    ++output.back().second;
+  }
+}
+
+template <typename Metric, size_t Q>
+bool QGramIndex<Metric, Q>::insert(std::string_view value) {
+  if (m_words.size() >= std::numeric_limits<id_type>::max()) {
+    return false;
+  }
+  const auto id = static_cast<id_type>(m_words.size());
+  gram_list list;
+  grams(value, list);
+  for (auto const &[gram, count] : list) {
+    m_postings[gram].emplace_back(id, count);
+  }
+  if (m_lengths.size() <= value.size()) {
+    m_lengths.resize(value.size() + 1);
+  }
+  m_lengths[value.size()].push_back(id);
+  m_words.emplace_back(value);
+  return true;
+}
+
+template <typename Metric, size_t Q>
+ResultList QGramIndex<Metric, Q>::find(std::string_view value, int limit) const {
+  ResultList output;
+  if (limit < 0 || m_lengths.empty()) {
+    return output;
+  }
+  const size_t radius = static_cast<size_t>(limit);
+  const size_t min_length = value.size() > radius ? value.size() - radius : 0;
+  const size_t max_length = std::min(value.size() + radius, m_lengths.size() - 1);
+  // Shared q-grams a word of the given length needs to be a candidate
+  auto needed = [&](size_t length) {
+    return static_cast<std::ptrdiff_t>(std::max(value.size(), length) + Q - 1) -
+           static_cast<std::ptrdiff_t>(radius * helpers::grams_per_unit<Metric>(Q));
+  };
+
+  std::vector<id_type> candidates;
+  bool counting = false;
+  for (size_t length = min_length; length <= max_length; ++length) {
+    if (needed(length) <= 0) {
+      candidates.insert(candidates.end(), m_lengths[length].begin(),
+                        m_lengths[length].end());
+    } else {
+      counting |= !m_lengths[length].empty();
+    }
+  }
+  if (counting) {
+    thread_local std::vector<id_type> shared, touched;
+    thread_local gram_list query;
+    shared.resize(std::max(shared.size(), m_words.size()));
+    grams(value, query);
+    for (auto const &[gram, count] : query) {
+      auto it = m_postings.find(gram);
+      if (it == m_postings.end()) {
+        continue;
+      }
+      for (auto const &[id, occurrences] : it->second) {
+        if (shared[id] == 0) {
+          touched.push_back(id);
+        }
+        shared[id] += std::min(count, occurrences);
+      }
+    }
+    for (id_type id : touched) {
+      const size_t length = m_words[id].size();
+      const auto required = needed(length);
+      if (length >= min_length && length <= max_length && required > 0 &&
+          shared[id] >= static_cast<size_t>(required)) {
+        candidates.push_back(id);
+      }
+      shared[id] = 0;
+    }
+    touched.clear();
+  }
+
+  std::sort(candidates.begin(), candidates.end());
+  // Verified in one batch against the prepared query
+  std::vector<std::string_view> words(candidates.size());
+  std::vector<integer_type> distances(candidates.size());
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    words[i] = m_words[candidates[i]];
+  }
+  m_metric.prepare(value).batch(words, distances);
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    const int distance = static_cast<int>(distances[i]);
+    if (distance >= 0 && distance <= limit) {
+      output.emplace_back(words[i], distance);
+    }
+  }
+  return output;
+}
+
+} // namespace bk_tree
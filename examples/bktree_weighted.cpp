@@ -0,0 +1,34 @@
+#include "bktree.hpp"
+#include <iostream>
+#include <string>
+#include <vector>
+
+void example() {
+  using metric_t = bk_tree::metrics::WeightedEditDistance<bk_tree::metrics::QwertyCost>;
+  bk_tree::BKTree<metric_t> tree;
+  {
+    std::vector<std::string> input{"tall", "tell",  "teel",  "feel", "tally",
+                                   "tuck", "belly", "kelly", "kill", "tal"};
+    for (auto &s : input) {
+      tree.insert(s);
+    }
+  }
+
+  std::cout << "Tree size: " << tree.size() << std::endl << std::endl;
+
+  bk_tree::ResultList results;
+  auto target = "tslk";
+  for (int limit = 2; limit <= 4; limit++) {
+    std::cout << "Limit: " << limit << std::endl;
+    results = tree.find(target, limit);
+    for (auto &p : results) {
+      std::cout << p.first << " " << p.second << std::endl;
+    }
+    std::cout << std::endl;
+  }
+}
+
+int main() {
+  example();
+  return 0;
+}
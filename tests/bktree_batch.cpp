@@ -0,0 +1,87 @@
+#include "gtest/gtest.h"
+
+#include "bktree.hpp"
+#include "random_words.hpp"
+#include <ranges>
+#include <sstream>
+
+namespace bk_tree_test {
+
+class BKTree_Batch_TEST : public ::testing::Test {
+protected:
+  BKTree_Batch_TEST() {
+    words = random_words(500, 11, 3, 8, 'f');
+    for (auto &w : words) {
+      tree.insert(w);
+    }
+  }
+
+  virtual ~BKTree_Batch_TEST() {}
+
+  virtual void SetUp() {
+    // post-construction
+  }
+
+  virtual void TearDown() {
+    // pre-destruction
+  }
+
+  std::vector<std::string> words;
+  bk_tree::BKTree<bk_tree::metrics::EditDistance> tree;
+};
+
+TEST_F(BKTree_Batch_TEST, BatchMatchesFind) {
+  std::vector<std::string> queries(words.begin(), words.begin() + 40);
+  queries.push_back("zzzzzz");
+  queries.push_back("");
+  queries.push_back(queries.front());
+  for (int limit = 0; limit <= 3; ++limit) {
+    auto results = tree.find_batch(queries, limit);
+    ASSERT_EQ(results.size(), queries.size());
+    for (size_t i = 0; i < queries.size(); ++i) {
+      EXPECT_EQ(results[i], tree.find(queries[i], limit)) << queries[i];
+    }
+  }
+}
+
+TEST_F(BKTree_Batch_TEST, BatchOfTemporaries) {
+  std::vector<std::string> stems(words.begin(), words.begin() + 40);
+  auto queries =
+      stems | std::views::transform([](const std::string &s) { return s + "f"; });
+  auto results = tree.find_batch(queries, 2);
+  ASSERT_EQ(results.size(), stems.size());
+  for (size_t i = 0; i < stems.size(); ++i) {
+    EXPECT_EQ(results[i], tree.find(stems[i] + "f", 2)) << stems[i];
+  }
+
+  std::istringstream in("abc fed aaaa");
+  auto streamed = tree.find_batch(std::views::istream<std::string>(in), 1);
+  ASSERT_EQ(streamed.size(), 3);
+  EXPECT_EQ(streamed[0], tree.find("abc", 1));
+  EXPECT_EQ(streamed[1], tree.find("fed", 1));
+  EXPECT_EQ(streamed[2], tree.find("aaaa", 1));
+}
+
+TEST_F(BKTree_Batch_TEST, BatchWithoutBounds) {
+  bk_tree::BKTree<bk_tree::metrics::HammingDistance> hamming;
+  for (auto &w : words) {
+    hamming.insert(w);
+  }
+  std::vector<std::string_view> queries{"abcdef", "aaaa", "fed"};
+  auto results = hamming.find_batch(queries, 2);
+  ASSERT_EQ(results.size(), 3);
+  for (size_t i = 0; i < queries.size(); ++i) {
+    EXPECT_EQ(results[i], hamming.find(queries[i], 2));
+  }
+}
+
+TEST_F(BKTree_Batch_TEST, BatchEmpty) {
+  EXPECT_TRUE(tree.find_batch(std::vector<std::string_view>{}, 2).empty());
+  bk_tree::BKTree<bk_tree::metrics::EditDistance> empty;
+  auto results = empty.find_batch(std::vector<std::string_view>{"a", "b"}, 2);
+  ASSERT_EQ(results.size(), 2);
+  EXPECT_TRUE(results[0].empty());
+  EXPECT_TRUE(results[1].empty());
+}
+
+} // namespace bk_tree_test
@@ -0,0 +1,90 @@
+#include "gtest/gtest.h"
+
+#include "bktree.hpp"
+#include "random_words.hpp"
+#include <set>
+
+namespace bk_tree_test {
+
+class BKTree_Bounded_TEST : public ::testing::Test {
+protected:
+  BKTree_Bounded_TEST() {
+    words = random_words(3000, 17, 3, 8, 'f');
+    for (auto &w : words) {
+      tree.insert(w);
+    }
+  }
+
+  virtual ~BKTree_Bounded_TEST() {}
+
+  virtual void SetUp() {
+    // post-construction
+  }
+
+  virtual void TearDown() {
+    // pre-destruction
+  }
+
+  static bk_tree::SearchBudget evaluations(size_t count) {
+    bk_tree::SearchBudget budget;
+    budget.max_evaluations = count;
+    return budget;
+  }
+
+  static bk_tree::SearchBudget deadline(std::chrono::steady_clock::time_point at) {
+    bk_tree::SearchBudget budget;
+    budget.deadline = at;
+    return budget;
+  }
+
+  static std::multiset<bk_tree::ResultEntry> as_set(const bk_tree::ResultList &list) {
+    return {list.begin(), list.end()};
+  }
+
+  std::vector<std::string> words;
+  bk_tree::BKTree<bk_tree::metrics::EditDistance> tree;
+};
+
+TEST_F(BKTree_Bounded_TEST, UnlimitedMatchesFind) {
+  for (size_t i = 0; i < words.size(); i += 97) {
+    for (int limit = 0; limit <= 3; ++limit) {
+      auto bounded = tree.find_bounded(words[i], limit, {});
+      EXPECT_TRUE(bounded.complete);
+      EXPECT_EQ(as_set(bounded.results), as_set(tree.find(words[i], limit)));
+      EXPECT_TRUE(std::is_sorted(
+          bounded.results.begin(), bounded.results.end(),
+          [](auto const &a, auto const &b) { return a.second < b.second; }));
+    }
+  }
+}
+
+TEST_F(BKTree_Bounded_TEST, EvaluationBudget) {
+  const auto exact = as_set(tree.find("abcdef", 3));
+  for (size_t budget : {0, 1, 50, 400}) {
+    auto bounded = tree.find_bounded("abcdef", 3, evaluations(budget));
+    EXPECT_FALSE(bounded.complete);
+    EXPECT_EQ(bounded.evaluations, budget);
+    for (auto const &entry : bounded.results) {
+      EXPECT_TRUE(exact.contains(entry));
+    }
+  }
+  auto bounded = tree.find_bounded("abcdef", 3, evaluations(words.size()));
+  EXPECT_TRUE(bounded.complete);
+  EXPECT_EQ(as_set(bounded.results), exact);
+}
+
+TEST_F(BKTree_Bounded_TEST, ExpiredDeadline) {
+  const auto now = std::chrono::steady_clock::now();
+  auto expired = tree.find_bounded("abcdef", 2, deadline(now));
+  EXPECT_FALSE(expired.complete);
+  EXPECT_EQ(expired.evaluations, 0);
+  EXPECT_TRUE(expired.results.empty());
+
+  auto later = tree.find_bounded("abcdef", 2, deadline(now + std::chrono::hours(1)));
+  EXPECT_TRUE(later.complete);
+
+  bk_tree::BKTree<bk_tree::metrics::EditDistance> empty;
+  EXPECT_TRUE(empty.find_bounded("abcdef", 2, deadline(now)).complete);
+}
+
+} // namespace bk_tree_test
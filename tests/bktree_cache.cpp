@@ -0,0 +1,143 @@
+#include "gtest/gtest.h"
+
+#include "cache.hpp"
+#include <set>
+#include <thread>
+
+namespace bk_tree_test {
+
+class BKTree_Cache_TEST : public ::testing::Test {
+protected:
+  BKTree_Cache_TEST() : tree(2) {
+    std::vector<std::string> input{"tall", "tell",  "teel",  "feel", "tally",
+                                   "tuck", "belly", "kelly", "kill", "tal"};
+    for (auto &s : input) {
+      tree.insert(s);
+    }
+  }
+
+  virtual ~BKTree_Cache_TEST() {}
+
+  virtual void SetUp() {
+    // post-construction
+  }
+
+  virtual void TearDown() {
+    // pre-destruction
+  }
+
+  static std::multiset<bk_tree::ResultEntry>
+  as_set(const bk_tree::ResultList &results) {
+    return {results.begin(), results.end()};
+  }
+
+  bk_tree::CachedBKTree<bk_tree::metrics::EditDistance> tree;
+};
+
+TEST_F(BKTree_Cache_TEST, CacheHitsAndMisses) {
+  auto first = tree.find("tale", 1);
+  EXPECT_EQ(tree.cache_misses(), 1);
+  EXPECT_EQ(tree.cache_hits(), 0);
+  auto second = tree.find("tale", 1);
+  EXPECT_EQ(tree.cache_hits(), 1);
+  EXPECT_EQ(first, second);
+  static_cast<void>(tree.find("tale", 2));
+  EXPECT_EQ(tree.cache_misses(), 2);
+  EXPECT_EQ(tree.cache_size(), 2);
+}
+
+TEST_F(BKTree_Cache_TEST, CacheEviction) {
+  static_cast<void>(tree.find("tale", 1));
+  static_cast<void>(tree.find("tell", 1));
+  static_cast<void>(tree.find("kill", 1));
+  EXPECT_EQ(tree.cache_size(), 2);
+  static_cast<void>(tree.find("tell", 1));
+  EXPECT_EQ(tree.cache_hits(), 1);
+  static_cast<void>(tree.find("tale", 1));
+  EXPECT_EQ(tree.cache_hits(), 1);
+  EXPECT_EQ(tree.cache_misses(), 4);
+}
+
+TEST_F(BKTree_Cache_TEST, CacheUpdatedByInsertAndErase) {
+  bk_tree::BKTree<bk_tree::metrics::EditDistance> reference{
+      "tall", "tell", "teel", "feel", "tally", "tuck", "belly", "kelly", "kill", "tal"};
+  static_cast<void>(tree.find("tale", 1));
+  tree.insert("tale");
+  reference.insert("tale");
+  EXPECT_EQ(as_set(tree.find("tale", 1)), as_set(reference.find("tale", 1)));
+  EXPECT_EQ(tree.cache_hits(), 1);
+
+  tree.erase("tall");
+  reference.erase("tall");
+  EXPECT_EQ(as_set(tree.find("tale", 1)), as_set(reference.find("tale", 1)));
+  EXPECT_EQ(tree.cache_hits(), 2);
+
+  EXPECT_FALSE(tree.erase("tall"));
+  tree.clear_cache();
+  EXPECT_EQ(tree.cache_size(), 0);
+  EXPECT_EQ(as_set(tree.find("tale", 1)), as_set(reference.find("tale", 1)));
+}
+
+TEST_F(BKTree_Cache_TEST, InsertEvictsPastPatchBudget) {
+  // Every query is within 3 of the inserted word, so none is ruled out cheaply
+  bk_tree::CachedBKTree<bk_tree::metrics::EditDistance> large(1000);
+  bk_tree::BKTree<bk_tree::metrics::EditDistance> reference;
+  std::vector<std::string> queries;
+  for (char a = 'a'; a <= 'z'; ++a) {
+    for (char b = 'a'; b <= 'e'; ++b) {
+      queries.push_back(std::string("tal") + a + b);
+    }
+  }
+  for (auto &q : queries) {
+    large.insert(q);
+    reference.insert(q);
+  }
+  for (auto &q : queries) {
+    static_cast<void>(large.find(q, 3));
+  }
+  ASSERT_GT(queries.size(), BK_CACHE_PATCH_BUDGET);
+  EXPECT_EQ(large.cache_size(), queries.size());
+
+  large.insert("tale");
+  reference.insert("tale");
+  EXPECT_EQ(large.cache_size(), BK_CACHE_PATCH_BUDGET);
+  const size_t hits = large.cache_hits();
+  for (auto &q : queries) {
+    EXPECT_EQ(as_set(large.find(q, 3)), as_set(reference.find(q, 3))) << q;
+  }
+  EXPECT_EQ(large.cache_hits() - hits, BK_CACHE_PATCH_BUDGET);
+}
+
+TEST_F(BKTree_Cache_TEST, CacheConcurrentReadersAndWriter) {
+  const std::vector<std::string> queries{"tale", "tel", "bell", "kil"};
+  std::vector<std::thread> readers;
+  for (int r = 0; r < 4; ++r) {
+    readers.emplace_back([&] {
+      for (int n = 0; n < 200; ++n) {
+        for (auto &q : queries) {
+          for (auto const &p : tree.find(q, 1 + n % 2)) {
+            EXPECT_LE(p.second, 1 + n % 2);
+          }
+        }
+      }
+    });
+  }
+  for (int n = 0; n < 100; ++n) {
+    tree.insert("tale" + std::to_string(n % 10));
+    tree.erase("tale" + std::to_string((n + 5) % 10));
+  }
+  for (auto &reader : readers) {
+    reader.join();
+  }
+
+  bk_tree::BKTree<bk_tree::metrics::EditDistance> reference;
+  for (auto const &p : tree.find("tale", 100)) {
+    reference.insert(p.first);
+  }
+  EXPECT_EQ(reference.size(), tree.size());
+  for (auto &q : queries) {
+    EXPECT_EQ(as_set(tree.find(q, 1)), as_set(reference.find(q, 1)));
+  }
+}
+
+} // namespace bk_tree_test
@@ -0,0 +1,102 @@
+#include "gtest/gtest.h"
+
+#include "compact.hpp"
+#include "random_words.hpp"
+#include <memory_resource>
+#include <random>
+
+namespace bk_tree_test {
+
+class BKTree_Compact_TEST : public ::testing::Test {
+protected:
+  BKTree_Compact_TEST() {
+    words = random_words(3000, 17, 0, 9, 'e');
+    std::mt19937 rng(17);
+    for (auto &w : words) {
+      // Shared prefixes, a few long enough for two-byte varints
+      w.insert(0, rng() % 64 == 0 ? 130 : rng() % 3, 'p');
+    }
+    // Duplicates
+    words.insert(words.end(), words.begin(), words.begin() + 300);
+    for (auto &w : words) {
+      tree.insert(w);
+    }
+    queries.assign(words.begin(), words.begin() + 200);
+    for (auto &q : queries) {
+      q.push_back('z');
+    }
+  }
+
+  virtual ~BKTree_Compact_TEST() {}
+
+  virtual void SetUp() {
+    // post-construction
+  }
+
+  virtual void TearDown() {
+    // pre-destruction
+  }
+
+  using tree_type = bk_tree::BKTree<bk_tree::metrics::EditDistance>;
+  using compact_type = bk_tree::CompactBKTree<bk_tree::metrics::EditDistance>;
+
+  std::vector<std::string> words, queries;
+  tree_type tree;
+};
+
+TEST_F(BKTree_Compact_TEST, SameResultsAsTree) {
+  const compact_type compact(tree);
+  EXPECT_EQ(compact.size(), tree.size());
+  for (int limit = 0; limit <= 3; ++limit) {
+    for (auto &q : queries) {
+      EXPECT_EQ(compact.find(q, limit), tree.find(q, limit)) << q;
+    }
+  }
+  for (size_t i = 0; i < words.size(); i += 7) {
+    EXPECT_EQ(compact.find(words[i], 0), tree.find(words[i], 0)) << words[i];
+  }
+}
+
+TEST_F(BKTree_Compact_TEST, BuildsFromWords) {
+  const compact_type compact(words);
+  EXPECT_EQ(compact.size(), words.size());
+  for (auto &q : queries) {
+    EXPECT_EQ(compact.find(q, 2), tree.find(q, 2)) << q;
+  }
+
+  const compact_type small{"tall", "tell", "tall"};
+  EXPECT_EQ(small.find("tall", 1).size(), 3);
+  EXPECT_TRUE(compact_type(tree_type()).empty());
+  EXPECT_TRUE(compact_type(tree_type()).find("tall", 5).empty());
+}
+
+// Counts the bytes outstanding in a tree allocated from it
+class CountingResource : public std::pmr::memory_resource {
+public:
+  size_t bytes = 0;
+
+private:
+  void *do_allocate(size_t size, size_t alignment) override {
+    bytes += size;
+    return std::pmr::new_delete_resource()->allocate(size, alignment);
+  }
+  void do_deallocate(void *p, size_t size, size_t alignment) override {
+    bytes -= size;
+    std::pmr::new_delete_resource()->deallocate(p, size, alignment);
+  }
+  bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+    return this == &other;
+  }
+};
+
+TEST_F(BKTree_Compact_TEST, SmallerThanTree) {
+  CountingResource resource;
+  tree_type counted(&resource);
+  for (auto &w : words) {
+    counted.insert(w);
+  }
+  const compact_type compact(counted);
+  EXPECT_LT(compact.memory_usage() * 4, resource.bytes);
+}
+
+} // namespace bk_tree_test
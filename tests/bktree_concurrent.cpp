@@ -0,0 +1,251 @@
+#include "gtest/gtest.h"
+
+#include "concurrent.hpp"
+#include "random_words.hpp"
+#include <atomic>
+#include <random>
+#include <set>
+#include <thread>
+#include <utility>
+
+namespace bk_tree_test {
+
+class BKTree_Concurrent_TEST : public ::testing::Test {
+protected:
+  BKTree_Concurrent_TEST() {
+    // The first 300 distinct words are stable, the next 300 churn
+    std::set<std::string> seen;
+    for (auto &w : random_words(1000, 3, 3, 7, 'f')) {
+      if (churn.size() < 300 && seen.insert(w).second) {
+        (stable.size() < 300 ? stable : churn).push_back(w);
+      }
+    }
+  }
+
+  virtual ~BKTree_Concurrent_TEST() {}
+
+  virtual void SetUp() {
+    // post-construction
+  }
+
+  virtual void TearDown() {
+    // pre-destruction
+  }
+
+  bk_tree::metrics::EditDistance metric;
+  std::vector<std::string> stable, churn;
+};
+
+TEST_F(BKTree_Concurrent_TEST, SingleThreaded) {
+  bk_tree::ConcurrentBKTree<bk_tree::metrics::EditDistance> tree{"book", "books",
+                                                                 "cake", "boo"};
+  EXPECT_EQ(tree.size(), 4);
+  EXPECT_FALSE(tree.insert("book"));
+  EXPECT_TRUE(tree.erase("book"));
+  EXPECT_FALSE(tree.erase("book"));
+  EXPECT_EQ(tree.size(), 3);
+  EXPECT_EQ(tree.find("book", 1).size(), 2);
+  EXPECT_TRUE(tree.insert("book"));
+  EXPECT_EQ(tree.find("book", 1).size(), 3);
+  for (auto w : {"book", "books", "cake", "boo"}) {
+    EXPECT_TRUE(tree.erase(w));
+  }
+  EXPECT_TRUE(tree.empty());
+  EXPECT_TRUE(tree.find("book", 5).empty());
+  EXPECT_TRUE(tree.insert("cake"));
+  EXPECT_EQ(tree.find("cake", 0).size(), 1);
+}
+
+TEST_F(BKTree_Concurrent_TEST, ReadersWithWriter) {
+  bk_tree::ConcurrentBKTree<bk_tree::metrics::EditDistance> tree;
+  for (size_t i = 0; i < stable.size(); ++i) {
+    tree.insert(stable[i]);
+    if (i % 3 == 0) {
+      tree.insert(churn[i]);
+    }
+  }
+
+  std::atomic<bool> done = false;
+  std::atomic<size_t> checked = 0;
+  std::vector<std::thread> readers;
+  for (int r = 0; r < 4; ++r) {
+    readers.emplace_back([&, r] {
+      bk_tree::metrics::EditDistance distance;
+      for (size_t n = r; !done.load() || n < 200; n += 4) {
+        auto const &query = stable[n % stable.size()];
+        const int limit = 1 + n % 2;
+        std::set<std::string> found;
+        for (auto const &[word, d] : tree.find(query, limit)) {
+          EXPECT_EQ(static_cast<int>(distance(query, word)), d);
+          EXPECT_LE(d, limit);
+          EXPECT_TRUE(found.insert(word).second) << "duplicate " << word;
+        }
+        // Words never touched by the writer must always be found
+        for (auto const &w : stable) {
+          if (static_cast<int>(distance(query, w)) <= limit) {
+            EXPECT_TRUE(found.contains(w)) << query << " misses " << w;
+          }
+        }
+        checked.fetch_add(1);
+      }
+    });
+  }
+
+  std::set<std::string> reference(stable.begin(), stable.end());
+  for (size_t i = 0; i < stable.size(); i += 3) {
+    reference.insert(churn[i]);
+  }
+  std::mt19937 rng(5);
+  for (int n = 0; n < 3000; ++n) {
+    auto const &w = churn[rng() % churn.size()];
+    if (rng() % 2) {
+      EXPECT_EQ(tree.insert(w), reference.insert(w).second);
+    } else {
+      EXPECT_EQ(tree.erase(w), reference.erase(w) == 1);
+    }
+  }
+  done = true;
+  for (auto &reader : readers) {
+    reader.join();
+  }
+  EXPECT_GE(checked.load(), 200);
+
+  EXPECT_EQ(tree.size(), reference.size());
+  for (auto const &query : churn) {
+    std::set<std::string> expected, actual;
+    for (auto const &w : reference) {
+      if (metric(query, w) <= 2) {
+        expected.insert(w);
+      }
+    }
+    for (auto const &p : tree.find(query, 2)) {
+      actual.insert(p.first);
+    }
+    EXPECT_EQ(actual, expected);
+  }
+}
+
+TEST_F(BKTree_Concurrent_TEST, ConcurrentInserts) {
+  bk_tree::ConcurrentBKTree<bk_tree::metrics::EditDistance> tree;
+  std::vector<std::string> words(stable);
+  words.insert(words.end(), churn.begin(), churn.end());
+
+  // Every producer inserts every word, so each word races with itself
+  std::atomic<size_t> successes = 0;
+  std::atomic<bool> done = false;
+  std::vector<std::thread> threads;
+  for (int p = 0; p < 4; ++p) {
+    threads.emplace_back([&, p] {
+      for (size_t i = 0; i < words.size(); ++i) {
+        if (tree.insert(words[(i * 7 + p * 131) % words.size()])) {
+          successes.fetch_add(1);
+        }
+      }
+    });
+  }
+  std::thread reader([&] {
+    while (!done.load()) {
+      for (auto const &[word, d] : tree.find(stable[0], 2)) {
+        EXPECT_EQ(static_cast<int>(metric(stable[0], word)), d);
+      }
+    }
+  });
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  done = true;
+  reader.join();
+
+  EXPECT_EQ(successes.load(), words.size());
+  EXPECT_EQ(tree.size(), words.size());
+  for (auto const &query : stable) {
+    std::set<std::string> expected, actual;
+    for (auto const &w : words) {
+      if (metric(query, w) <= 1) {
+        expected.insert(w);
+      }
+    }
+    for (auto const &p : tree.find(query, 1)) {
+      EXPECT_TRUE(actual.insert(p.first).second);
+    }
+    EXPECT_EQ(actual, expected);
+  }
+}
+
+TEST_F(BKTree_Concurrent_TEST, ConcurrentInsertsWithErase) {
+  bk_tree::ConcurrentBKTree<bk_tree::metrics::EditDistance> tree;
+  std::vector<std::thread> threads;
+  for (int p = 0; p < 3; ++p) {
+    threads.emplace_back([&, p] {
+      for (size_t i = p; i < stable.size(); i += 3) {
+        tree.insert(stable[i]);
+      }
+    });
+  }
+  for (size_t i = 0; i < churn.size(); ++i) {
+    tree.insert(churn[i]);
+    if (i % 2 == 0) {
+      tree.erase(churn[i]);
+    }
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(tree.size(), stable.size() + churn.size() / 2);
+  for (size_t i = 0; i < churn.size(); ++i) {
+    EXPECT_EQ(tree.find(churn[i], 0).size(), i % 2);
+  }
+}
+
+TEST_F(BKTree_Concurrent_TEST, RebuildAlongsideReaders) {
+  bk_tree::ConcurrentBKTree<bk_tree::metrics::EditDistance> tree;
+  tree.set_rebuild_policy({0.05, 100});
+  EXPECT_EQ(std::as_const(tree).rebuild_policy().min_size, 100);
+  for (size_t i = 0; i < stable.size(); ++i) {
+    tree.insert(churn[i]);
+    tree.insert(stable[i]);
+  }
+
+  std::atomic<bool> done = false;
+  std::vector<std::thread> readers;
+  for (int r = 0; r < 2; ++r) {
+    readers.emplace_back([&, r] {
+      for (size_t n = r; !done.load(); n += 2) {
+        auto const &query = stable[n % stable.size()];
+        std::set<std::string> found;
+        for (auto const &p : tree.find(query, 1)) {
+          found.insert(p.first);
+        }
+        for (auto const &w : stable) {
+          if (metric(query, w) <= 1) {
+            EXPECT_TRUE(found.contains(w)) << query << " misses " << w;
+          }
+        }
+      }
+    });
+  }
+  // Erasing the earlier, inner words leaves tombstones behind
+  for (size_t i = 0; i < churn.size(); ++i) {
+    EXPECT_TRUE(tree.erase(churn[i]));
+    if (i % 50 == 0) {
+      tree.rebuild();
+      EXPECT_EQ(tree.degradation(), 0.0);
+    }
+  }
+  done = true;
+  for (auto &reader : readers) {
+    reader.join();
+  }
+
+  EXPECT_EQ(tree.size(), stable.size());
+  tree.rebuild();
+  EXPECT_EQ(tree.degradation(), 0.0);
+  EXPECT_EQ(tree.size(), stable.size());
+  for (auto const &w : churn) {
+    EXPECT_TRUE(tree.find(w, 0).empty());
+    EXPECT_TRUE(tree.insert(w));
+  }
+  EXPECT_EQ(tree.size(), stable.size() + churn.size());
+}
+
+} // namespace bk_tree_test
@@ -0,0 +1,193 @@
+#include "gtest/gtest.h"
+
+#include "durable.hpp"
+#include <csignal>
+#include <set>
+#include <sys/resource.h>
+#include <sstream>
+#include <thread>
+
+namespace bk_tree_test {
+
+class BKTree_Durable_TEST : public ::testing::Test {
+protected:
+  BKTree_Durable_TEST()
+      : directory(std::filesystem::temp_directory_path() /
+                  ("bktree_durable_test_" + std::to_string(::getpid()))) {
+    std::filesystem::remove_all(directory);
+  }
+
+  virtual ~BKTree_Durable_TEST() { std::filesystem::remove_all(directory); }
+
+  virtual void SetUp() {
+    // post-construction
+  }
+
+  virtual void TearDown() {
+    // pre-destruction
+  }
+
+  template <typename Tree>
+  static std::multiset<bk_tree::ResultEntry> contents(const Tree &tree) {
+    auto results = tree.find("", 100);
+    return {results.begin(), results.end()};
+  }
+
+  using durable_type = bk_tree::DurableBKTree<bk_tree::metrics::EditDistance>;
+
+  std::filesystem::path directory;
+  std::vector<std::string> input{"tall", "tell",  "teel",  "feel", "tally",
+                                 "tuck", "belly", "kelly", "kill", "tall"};
+};
+
+TEST_F(BKTree_Durable_TEST, SerializeRoundTrip) {
+  bk_tree::BKTree<bk_tree::metrics::EditDistance> tree;
+  for (auto &s : input) {
+    tree.insert(s);
+  }
+  std::stringstream buffer;
+  tree.serialize(buffer);
+  auto copy = bk_tree::BKTree<bk_tree::metrics::EditDistance>::deserialize(buffer);
+  EXPECT_EQ(copy.size(), tree.size());
+  for (int limit = 0; limit <= 3; ++limit) {
+    EXPECT_EQ(copy.find("tale", limit), tree.find("tale", limit));
+  }
+
+  using tree_type = bk_tree::BKTree<bk_tree::metrics::EditDistance>;
+  std::stringstream truncated(buffer.str().substr(0, buffer.str().size() - 3));
+  EXPECT_THROW(static_cast<void>(tree_type::deserialize(truncated)),
+               std::runtime_error);
+}
+
+TEST_F(BKTree_Durable_TEST, RecoverFromLog) {
+  {
+    durable_type tree(directory);
+    for (auto &s : input) {
+      EXPECT_TRUE(tree.insert(s));
+    }
+    EXPECT_TRUE(tree.erase("tuck"));
+    EXPECT_FALSE(tree.erase("tuck"));
+  }
+  durable_type recovered(directory);
+  EXPECT_EQ(recovered.replayed(), input.size() + 1);
+  EXPECT_EQ(recovered.size(), input.size() - 1);
+  EXPECT_TRUE(recovered.find("tuck", 0).empty());
+  EXPECT_EQ(recovered.find("tall", 0).size(), 2);
+}
+
+TEST_F(BKTree_Durable_TEST, RecoverFromCheckpoint) {
+  std::multiset<bk_tree::ResultEntry> expected;
+  {
+    durable_type tree(directory);
+    for (auto &s : input) {
+      tree.insert(s);
+    }
+    tree.checkpoint();
+    tree.insert("tale");
+    tree.erase("kill");
+    expected = contents(tree);
+  }
+  durable_type recovered(directory);
+  EXPECT_EQ(recovered.replayed(), 2);
+  EXPECT_EQ(contents(recovered), expected);
+}
+
+TEST_F(BKTree_Durable_TEST, AutomaticCheckpoint) {
+  {
+    durable_type tree(directory, bk_tree::metrics::EditDistance(), 64);
+    for (auto &s : input) {
+      tree.insert(s);
+    }
+    EXPECT_LT(tree.log_bytes(), 64);
+  }
+  durable_type recovered(directory);
+  EXPECT_LT(recovered.replayed(), input.size());
+  EXPECT_EQ(recovered.size(), input.size());
+}
+
+TEST_F(BKTree_Durable_TEST, ResetFromTree) {
+  {
+    bk_tree::BKTree<bk_tree::metrics::EditDistance> tree;
+    for (auto &s : input) {
+      tree.insert(s);
+    }
+    durable_type durable(directory);
+    durable.insert("stale");
+    durable.reset(std::move(tree));
+    durable.insert("tale");
+  }
+  durable_type recovered(directory);
+  EXPECT_EQ(recovered.replayed(), 1);
+  EXPECT_EQ(recovered.size(), input.size() + 1);
+  EXPECT_TRUE(recovered.find("stale", 0).empty());
+}
+
+TEST_F(BKTree_Durable_TEST, TornTailIsDiscarded) {
+  {
+    durable_type tree(directory);
+    tree.insert("tall");
+    tree.insert("tell");
+  }
+  {
+    std::ofstream log(directory / "log", std::ios::binary | std::ios::app);
+    log.write("\x01\x10\x00\x00\x00te", 7);
+  }
+  {
+    durable_type recovered(directory);
+    EXPECT_EQ(recovered.size(), 2);
+    recovered.insert("teel");
+  }
+  durable_type recovered(directory);
+  EXPECT_EQ(recovered.replayed(), 3);
+  EXPECT_EQ(recovered.find("teel", 0).size(), 1);
+}
+
+TEST_F(BKTree_Durable_TEST, FailedFlushRefusesUpdates) {
+  {
+    durable_type tree(directory, bk_tree::metrics::EditDistance(), 0);
+    EXPECT_TRUE(tree.insert("tall"));
+    EXPECT_TRUE(tree.insert("tell"));
+    // Cap the file size at the log's, so the next append fails with EFBIG
+    rlimit saved;
+    ASSERT_EQ(::getrlimit(RLIMIT_FSIZE, &saved), 0);
+    auto handler = std::signal(SIGXFSZ, SIG_IGN);
+    rlimit capped = saved;
+    capped.rlim_cur = tree.log_bytes();
+    ASSERT_EQ(::setrlimit(RLIMIT_FSIZE, &capped), 0);
+    EXPECT_THROW(tree.insert("feel"), std::system_error);
+    ::setrlimit(RLIMIT_FSIZE, &saved);
+    std::signal(SIGXFSZ, handler);
+
+    const auto before = contents(tree);
+    EXPECT_THROW(tree.insert("kill"), std::system_error);
+    EXPECT_THROW(tree.erase("tall"), std::system_error);
+    EXPECT_EQ(contents(tree), before);
+    EXPECT_TRUE(tree.find("kill", 0).empty());
+  }
+  durable_type recovered(directory);
+  EXPECT_EQ(recovered.size(), 2);
+  EXPECT_EQ(recovered.find("tall", 0).size(), 1);
+}
+
+TEST_F(BKTree_Durable_TEST, ConcurrentWriters) {
+  {
+    durable_type tree(directory);
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 4; ++t) {
+      writers.emplace_back([&tree, t] {
+        for (int i = 0; i < 50; ++i) {
+          tree.insert(std::to_string(t * 1000 + i));
+        }
+      });
+    }
+    for (auto &writer : writers) {
+      writer.join();
+    }
+    EXPECT_EQ(tree.size(), 200);
+  }
+  durable_type recovered(directory);
+  EXPECT_EQ(recovered.size(), 200);
+  EXPECT_EQ(recovered.find("3049", 0).size(), 1);
+}
+
+} // namespace bk_tree_test
@@ -0,0 +1,134 @@
+#include "gtest/gtest.h"
+
+#include "bktree.hpp"
+#include "random_words.hpp"
+#include <set>
+
+namespace bk_tree_test {
+
+class BKTree_EraseMany_TEST : public ::testing::Test {
+protected:
+  BKTree_EraseMany_TEST() {
+    words = random_words(2000, 29, 2, 7, 'e');
+  }
+
+  virtual ~BKTree_EraseMany_TEST() {}
+
+  virtual void SetUp() {
+    // post-construction
+  }
+
+  virtual void TearDown() {
+    // pre-destruction
+  }
+
+  using tree_type = bk_tree::BKTree<bk_tree::metrics::EditDistance>;
+
+  tree_type build() const {
+    tree_type tree;
+    for (auto &w : words) {
+      tree.insert(w);
+    }
+    return tree;
+  }
+
+  static std::multiset<std::string> contents(const tree_type &tree) {
+    std::multiset<std::string> found;
+    for (auto word : tree.words()) {
+      found.emplace(word);
+    }
+    return found;
+  }
+
+  // Every word is found at distance 0 and its neighbourhood is complete
+  void expect_searchable(const tree_type &tree) const {
+    const auto present = contents(tree);
+    for (size_t i = 0; i < words.size(); i += 13) {
+      std::multiset<std::string> expected, found;
+      for (auto &w : present) {
+        if (bk_tree::metrics::EditDistance()(words[i], w) <= 2) {
+          expected.insert(w);
+        }
+      }
+      for (auto &[w, _] : tree.find(words[i], 2)) {
+        found.insert(w);
+      }
+      EXPECT_EQ(found, expected) << words[i];
+    }
+  }
+
+  std::vector<std::string> words;
+};
+
+TEST_F(BKTree_EraseMany_TEST, MatchesRepeatedErase) {
+  for (size_t step : {100, 10, 2}) {
+    std::vector<std::string> victims;
+    for (size_t i = 0; i < words.size(); i += step) {
+      victims.push_back(words[i]);
+    }
+    tree_type looped = build(), batched = build();
+    size_t erased = 0;
+    for (auto &v : victims) {
+      erased += looped.erase(v);
+    }
+    EXPECT_EQ(batched.erase_many(victims), erased);
+    EXPECT_EQ(batched.size(), looped.size());
+    EXPECT_EQ(contents(batched), contents(looped));
+    expect_searchable(batched);
+  }
+}
+
+TEST_F(BKTree_EraseMany_TEST, EraseIfTestsEveryWordOnce) {
+  tree_type tree = build();
+  std::multiset<std::string> tested;
+  const size_t erased = tree.erase_if([&](std::string_view w) {
+    tested.emplace(w);
+    return w.size() % 2 == 0;
+  });
+  EXPECT_EQ(tested, std::multiset<std::string>(words.begin(), words.end()));
+  std::multiset<std::string> expected;
+  for (auto &w : words) {
+    if (w.size() % 2 != 0) {
+      expected.insert(w);
+    }
+  }
+  EXPECT_EQ(erased, words.size() - expected.size());
+  EXPECT_EQ(contents(tree), expected);
+  expect_searchable(tree);
+
+  EXPECT_EQ(tree.erase_if([](std::string_view) { return true; }), expected.size());
+  EXPECT_TRUE(tree.empty());
+  EXPECT_EQ(tree.erase_if([](std::string_view) { return true; }), 0);
+}
+
+TEST_F(BKTree_EraseMany_TEST, ErasesTheRoot) {
+  tree_type tree = build();
+  const std::string root(*tree.words().begin());
+  const size_t copies = std::count(words.begin(), words.end(), root);
+  EXPECT_EQ(tree.erase_if([&](std::string_view w) { return w == root; }), copies);
+  EXPECT_EQ(tree.size(), words.size() - copies);
+  EXPECT_FALSE(tree.contains(root));
+  expect_searchable(tree);
+
+  tree_type pair{"tall", "tell"};
+  EXPECT_EQ(pair.erase_many(std::vector<std::string>{"tall", "tall"}), 1);
+  EXPECT_EQ(contents(pair), std::multiset<std::string>{"tell"});
+}
+
+TEST_F(BKTree_EraseMany_TEST, KeepsIndexAndPivots) {
+  tree_type tree = build();
+  tree.set_membership_index(true);
+  tree.select_pivots(4);
+  std::vector<std::string> victims(words.begin(), words.begin() + words.size() / 3);
+  EXPECT_EQ(tree.erase_many(victims), victims.size());
+  const auto present = contents(tree);
+  for (auto w : tree.words()) {
+    EXPECT_TRUE(tree.contains(w)) << w;
+  }
+  for (auto &w : victims) {
+    EXPECT_EQ(tree.contains(w), present.contains(w)) << w;
+  }
+  expect_searchable(tree);
+}
+
+} // namespace bk_tree_test
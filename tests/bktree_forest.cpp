@@ -0,0 +1,179 @@
+#include "gtest/gtest.h"
+
+#include "bkforest.hpp"
+#include <set>
+
+namespace bk_tree_test {
+
+// Hamming distance that counts comparisons between different lengths
+class CrossLengthHamming final : public bk_tree::metrics::Distance<CrossLengthHamming> {
+public:
+  static inline size_t cross_length = 0;
+  bk_tree::integer_type compute_distance(std::string_view s, std::string_view t) const {
+    cross_length += s.size() != t.size();
+    return bk_tree::metrics::HammingDistance()(s, t);
+  }
+};
+
+} // namespace bk_tree_test
+
+template <>
+struct bk_tree::helpers::is_fixed_length<bk_tree_test::CrossLengthHamming>
+    : std::true_type {};
+
+namespace bk_tree_test {
+
+class BKForest_TEST : public ::testing::Test {
+protected:
+  BKForest_TEST() : forest(4) {
+    std::vector<std::string> input{"tall", "tell",  "teel",  "feel", "tally",
+                                   "tuck", "belly", "kelly", "kill", "tal"};
+    for (auto &s : input) {
+      forest.insert(s);
+      tree.insert(s);
+    }
+  }
+
+  virtual ~BKForest_TEST() {}
+
+  virtual void SetUp() {
+    // post-construction
+  }
+
+  virtual void TearDown() {
+    // pre-destruction
+  }
+
+  static std::set<bk_tree::ResultEntry> as_set(const bk_tree::ResultList &results) {
+    return {results.begin(), results.end()};
+  }
+
+  bk_tree::BKForest<bk_tree::metrics::EditDistance> forest;
+  bk_tree::BKTree<bk_tree::metrics::EditDistance> tree;
+};
+
+TEST_F(BKForest_TEST, ForestSize) {
+  EXPECT_EQ(forest.size(), 10);
+  EXPECT_EQ(forest.shard_count(), 4);
+  size_t total = 0;
+  for (size_t i = 0; i < forest.shard_count(); ++i) {
+    total += forest.shard(i).size();
+  }
+  EXPECT_EQ(total, forest.size());
+}
+
+TEST_F(BKForest_TEST, ForestFindMatchesTree) {
+  for (int limit = 0; limit <= 4; limit++) {
+    auto results = forest.find("tale", limit);
+    EXPECT_EQ(results.size(), tree.find("tale", limit).size());
+    EXPECT_EQ(as_set(results), as_set(tree.find("tale", limit)));
+  }
+}
+
+TEST_F(BKForest_TEST, ForestErase) {
+  EXPECT_TRUE(forest.erase("tall"));
+  EXPECT_FALSE(forest.erase("tall"));
+  EXPECT_EQ(forest.size(), 9);
+  for (auto const &p : forest.find("tale", 2)) {
+    EXPECT_NE(p.first, "tall");
+  }
+}
+
+TEST_F(BKForest_TEST, ForestSingleShard) {
+  bk_tree::BKForest<bk_tree::metrics::EditDistance> single(1);
+  EXPECT_TRUE(single.empty());
+  single.insert("tall");
+  single.insert("tale");
+  EXPECT_EQ(single.find("tall", 1).size(), 2);
+}
+
+TEST_F(BKForest_TEST, ForestMovedFromIsUsable) {
+  auto moved = std::move(forest);
+  EXPECT_EQ(moved.size(), 10);
+  EXPECT_EQ(moved.shard_count(), 4);
+  EXPECT_EQ(as_set(moved.find("tale", 2)), as_set(tree.find("tale", 2)));
+  EXPECT_TRUE(forest.empty());
+  EXPECT_EQ(forest.shard_count(), 1);
+  EXPECT_TRUE(forest.find("tale", 2).empty());
+  EXPECT_TRUE(forest.insert("tale"));
+  EXPECT_EQ(forest.find("tale", 0).size(), 1);
+
+  bk_tree::BKForest<bk_tree::metrics::EditDistance> other(2);
+  other = std::move(moved);
+  EXPECT_EQ(other.size(), 10);
+  EXPECT_EQ(moved.shard_count(), 2);
+  EXPECT_TRUE(moved.insert("tall"));
+  EXPECT_TRUE(moved.erase("tall"));
+  EXPECT_TRUE(moved.find("tall", 1).empty());
+}
+
+class LengthBKForest_TEST : public ::testing::Test {
+protected:
+  LengthBKForest_TEST() {}
+
+  virtual ~LengthBKForest_TEST() {}
+
+  virtual void SetUp() {
+    // post-construction
+  }
+
+  virtual void TearDown() {
+    // pre-destruction
+  }
+
+  std::vector<std::string> input{"tall", "tell", "teel", "feel", "tally", "tuck",
+                                 "belly", "kelly", "kill", "tal", "tall", ""};
+};
+
+TEST_F(LengthBKForest_TEST, MixedLengths) {
+  bk_tree::LengthBKForest<bk_tree::metrics::HammingDistance> forest;
+  for (auto &s : input) {
+    EXPECT_TRUE(forest.insert(s));
+  }
+  EXPECT_EQ(forest.size(), input.size());
+  EXPECT_EQ(forest.partition_count(), 4);
+  EXPECT_EQ(forest.partition(5)->size(), 3);
+  EXPECT_EQ(forest.partition(6), nullptr);
+
+  bk_tree::metrics::HammingDistance distance;
+  for (std::string_view query : {"tale", "bally", "ta", "", "toll"}) {
+    for (int limit = 0; limit <= 3; ++limit) {
+      std::multiset<bk_tree::ResultEntry> expected;
+      for (auto &s : input) {
+        if (s.size() == query.size() && static_cast<int>(distance(query, s)) <= limit) {
+          expected.emplace(s, distance(query, s));
+        }
+      }
+      auto results = forest.find(query, limit);
+      EXPECT_EQ(std::multiset<bk_tree::ResultEntry>(results.begin(), results.end()),
+                expected);
+    }
+  }
+}
+
+TEST_F(LengthBKForest_TEST, NoCrossLengthDistances) {
+  bk_tree::LengthBKForest<CrossLengthHamming> forest;
+  for (auto &s : input) {
+    forest.insert(s);
+  }
+  EXPECT_EQ(forest.find("tale", 4).size(), 7);
+  EXPECT_EQ(forest.find("bally", 4).size(), 3);
+  forest.erase("belly");
+  EXPECT_EQ(CrossLengthHamming::cross_length, 0);
+}
+
+TEST_F(LengthBKForest_TEST, Erase) {
+  bk_tree::LengthBKForest<bk_tree::metrics::LeeDistance> forest{"ab", "abc", "abc"};
+  EXPECT_TRUE(forest.erase("ab"));
+  EXPECT_FALSE(forest.erase("ab"));
+  EXPECT_FALSE(forest.erase("abcd"));
+  EXPECT_EQ(forest.partition_count(), 1);
+  EXPECT_TRUE(forest.erase("abc"));
+  EXPECT_EQ(forest.find("abc", 0).size(), 1);
+  EXPECT_TRUE(forest.erase("abc"));
+  EXPECT_TRUE(forest.empty());
+  EXPECT_EQ(forest.partition_count(), 0);
+  EXPECT_TRUE(forest.find("abc", 2).empty());
+}
+
+} // namespace bk_tree_test
@@ -0,0 +1,114 @@
+#include "gtest/gtest.h"
+
+#include "join.hpp"
+#include "random_words.hpp"
+#include <mutex>
+#include <set>
+#include <tuple>
+
+namespace bk_tree_test {
+
+class BKTree_Join_TEST : public ::testing::Test {
+protected:
+  BKTree_Join_TEST() {
+    auto words = random_words(1600, 37, 2, 7, 'e');
+    left.assign(words.begin(), words.begin() + 800);
+    right.assign(words.begin() + 800, words.end());
+  }
+
+  virtual ~BKTree_Join_TEST() {}
+
+  virtual void SetUp() {
+    // post-construction
+  }
+
+  virtual void TearDown() {
+    // pre-destruction
+  }
+
+  using tree_type = bk_tree::BKTree<bk_tree::metrics::EditDistance>;
+  using pair_set = std::multiset<std::tuple<std::string, std::string, int>>;
+
+  static tree_type build(const std::vector<std::string> &words) {
+    tree_type tree;
+    for (auto &w : words) {
+      tree.insert(w);
+    }
+    return tree;
+  }
+
+  // Collects the pairs a join reports, from any thread
+  struct Collector {
+    std::mutex mutex;
+    pair_set pairs;
+    bool ordered = true;
+
+    void operator()(std::string_view s, std::string_view t, int distance) {
+      std::lock_guard lock(mutex);
+      if (ordered || s < t) {
+        pairs.emplace(s, t, distance);
+      } else {
+        pairs.emplace(t, s, distance);
+      }
+    }
+  };
+
+  std::vector<std::string> left, right;
+};
+
+TEST_F(BKTree_Join_TEST, SimilarityJoinMatchesFind) {
+  const tree_type a = build(left), b = build(right);
+  for (int limit = 0; limit <= 3; ++limit) {
+    pair_set expected;
+    for (auto &w : left) {
+      for (auto &[t, distance] : b.find(w, limit)) {
+        expected.emplace(w, t, distance);
+      }
+    }
+    for (size_t threads : {1, 4}) {
+      Collector collector;
+      bk_tree::similarity_join(a, b, limit, std::ref(collector), threads);
+      EXPECT_EQ(collector.pairs, expected) << limit << ' ' << threads;
+    }
+  }
+}
+
+TEST_F(BKTree_Join_TEST, SelfJoinReportsEachPairOnce) {
+  // Duplicates pair with each other
+  left.insert(left.end(), left.begin(), left.begin() + 50);
+  const tree_type tree = build(left);
+  for (int limit = 0; limit <= 3; ++limit) {
+    pair_set expected;
+    for (size_t i = 0; i < left.size(); ++i) {
+      for (size_t j = i + 1; j < left.size(); ++j) {
+        const int distance = bk_tree::metrics::EditDistance()(left[i], left[j]);
+        if (distance <= limit) {
+          expected.emplace(std::min(left[i], left[j]), std::max(left[i], left[j]),
+                           distance);
+        }
+      }
+    }
+    for (size_t threads : {1, 3, 16}) {
+      Collector collector;
+      collector.ordered = false;
+      bk_tree::self_join(tree, limit, std::ref(collector), threads);
+      EXPECT_EQ(collector.pairs, expected) << limit << ' ' << threads;
+    }
+  }
+}
+
+TEST_F(BKTree_Join_TEST, EmptyAndSingleWordTrees) {
+  size_t calls = 0;
+  auto count = [&](std::string_view, std::string_view, int) { ++calls; };
+  const tree_type empty, single{"tall"}, a = build(left);
+  bk_tree::self_join(empty, 2, count, 1);
+  bk_tree::self_join(single, 2, count, 4);
+  bk_tree::similarity_join(empty, a, 2, count, 4);
+  bk_tree::similarity_join(a, empty, 2, count, 1);
+  bk_tree::similarity_join(a, a, -1, count, 1);
+  EXPECT_EQ(calls, 0);
+  bk_tree::similarity_join(single, single, 0, count, 1);
+  EXPECT_EQ(calls, 1);
+}
+
+} // namespace bk_tree_test
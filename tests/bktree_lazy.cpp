@@ -0,0 +1,71 @@
+#include "gtest/gtest.h"
+
+#include "bktree.hpp"
+
+namespace bk_tree_test {
+
+class BKTree_Lazy_TEST : public ::testing::Test {
+protected:
+  BKTree_Lazy_TEST() {
+    std::vector<std::string> input{"book", "books", "cake", "boo", "boon",
+                                   "cook", "cake",  "cape", "cart"};
+    for (auto &s : input) {
+      tree.insert(s);
+    }
+  }
+
+  virtual ~BKTree_Lazy_TEST() {}
+
+  virtual void SetUp() {
+    // post-construction
+  }
+
+  virtual void TearDown() {
+    // pre-destruction
+  }
+
+  bk_tree::BKTree<bk_tree::metrics::EditDistance> tree;
+};
+
+TEST_F(BKTree_Lazy_TEST, LazyMatchesFind) {
+  for (int limit = 0; limit <= 4; ++limit) {
+    bk_tree::ResultList lazy;
+    for (auto &entry : tree.find_lazy("book", limit)) {
+      lazy.push_back(entry);
+    }
+    EXPECT_EQ(lazy, tree.find("book", limit));
+  }
+}
+
+TEST_F(BKTree_Lazy_TEST, LazyEarlyExit) {
+  int seen = 0;
+  for (auto const &[word, distance] : tree.find_lazy("book", 4)) {
+    EXPECT_LE(distance, 4);
+    if (++seen == 2) {
+      break;
+    }
+  }
+  EXPECT_EQ(seen, 2);
+}
+
+TEST_F(BKTree_Lazy_TEST, LazyEmptyTree) {
+  bk_tree::BKTree<bk_tree::metrics::EditDistance> empty;
+  auto generator = empty.find_lazy("book", 1);
+  EXPECT_TRUE(generator.begin() == generator.end());
+}
+
+TEST_F(BKTree_Lazy_TEST, LazyDegenerateTree) {
+  // IdentityDistance puts every word on a single chain
+  bk_tree::BKTree<bk_tree::metrics::IdentityDistance> chain;
+  for (int i = 0; i < 3000; ++i) {
+    chain.insert(std::to_string(i));
+  }
+  size_t count = 0;
+  for (auto const &entry : chain.find_lazy("x", 1)) {
+    EXPECT_EQ(entry.second, 1);
+    ++count;
+  }
+  EXPECT_EQ(count, chain.size());
+}
+
+} // namespace bk_tree_test
@@ -0,0 +1,188 @@
+#include "gtest/gtest.h"
+
+#include "bktree.hpp"
+#include "random_words.hpp"
+#include <memory>
+#include <set>
+
+namespace bk_tree_test {
+
+class BKTree_Membership_TEST : public ::testing::Test {
+protected:
+  BKTree_Membership_TEST() {
+    words = random_words(1000, 13, 2, 6, 'd');
+  }
+
+  virtual ~BKTree_Membership_TEST() {}
+
+  virtual void SetUp() {
+    // post-construction
+  }
+
+  virtual void TearDown() {
+    // pre-destruction
+  }
+
+  using tree_type = bk_tree::BKTree<bk_tree::metrics::EditDistance>;
+
+  std::vector<std::string> words;
+};
+
+TEST_F(BKTree_Membership_TEST, ContainsMatchesFind) {
+  tree_type tree;
+  for (size_t i = 0; i < words.size(); i += 2) {
+    tree.insert(words[i]);
+  }
+  for (bool indexed : {false, true}) {
+    tree.set_membership_index(indexed);
+    EXPECT_EQ(tree.has_membership_index(), indexed);
+    for (auto &w : words) {
+      EXPECT_EQ(tree.contains(w), !tree.find(w, 0).empty()) << w;
+    }
+  }
+  EXPECT_FALSE(tree_type().contains("tall"));
+}
+
+TEST_F(BKTree_Membership_TEST, IndexRejectsDuplicates) {
+  tree_type multiset, set;
+  set.set_membership_index(true);
+  std::set<std::string> distinct;
+  for (auto &w : words) {
+    multiset.insert(w);
+    EXPECT_EQ(set.insert(w), distinct.insert(w).second) << w;
+  }
+  EXPECT_EQ(multiset.size(), words.size());
+  EXPECT_EQ(set.size(), distinct.size());
+  for (auto &w : distinct) {
+    EXPECT_EQ(set.find(w, 0).size(), 1) << w;
+  }
+}
+
+TEST_F(BKTree_Membership_TEST, EraseKeepsIndexInStep) {
+  tree_type tree;
+  for (auto &w : words) {
+    tree.insert(w);
+  }
+  // Duplicates present before the index are counted
+  tree.set_membership_index(true);
+  EXPECT_EQ(tree.size(), words.size());
+  for (auto &w : words) {
+    EXPECT_TRUE(tree.erase(w)) << w;
+  }
+  EXPECT_TRUE(tree.empty());
+  for (auto &w : words) {
+    EXPECT_FALSE(tree.contains(w)) << w;
+    EXPECT_FALSE(tree.erase(w)) << w;
+  }
+  EXPECT_TRUE(tree.insert(words.front()));
+  EXPECT_TRUE(tree.contains(words.front()));
+}
+
+TEST_F(BKTree_Membership_TEST, EraseMissWithoutIndex) {
+  tree_type tree;
+  for (size_t i = 0; i < words.size(); i += 2) {
+    tree.insert(words[i]);
+  }
+  std::multiset<std::string> present(words.begin(), words.end());
+  for (size_t i = 1; i < words.size(); i += 2) {
+    present.erase(present.find(words[i]));
+  }
+  for (auto &w : words) {
+    auto it = present.find(w);
+    EXPECT_EQ(tree.erase(w), it != present.end()) << w;
+    if (it != present.end()) {
+      present.erase(it);
+    }
+  }
+  EXPECT_TRUE(tree.empty());
+}
+
+TEST_F(BKTree_Membership_TEST, IndexFollowsCopiesAndMerges) {
+  tree_type tree;
+  tree.set_membership_index(true);
+  for (size_t i = 0; i < words.size() / 2; ++i) {
+    tree.insert(words[i]);
+  }
+  tree_type copy(tree), rebuilt = tree.rebuilt();
+  EXPECT_TRUE(copy.has_membership_index());
+  EXPECT_TRUE(rebuilt.has_membership_index());
+  EXPECT_TRUE(copy.contains(words.front()));
+
+  tree_type other;
+  for (size_t i = words.size() / 2; i < words.size(); ++i) {
+    other.insert(words[i]);
+  }
+  tree.merge(std::move(other));
+  for (auto &w : words) {
+    EXPECT_TRUE(tree.contains(w)) << w;
+  }
+
+  auto storage = std::make_shared<std::vector<std::string>>(words);
+  std::vector<std::string_view> views(storage->begin(), storage->end());
+  std::set<std::string> fresh(words.begin() + words.size() / 2, words.end());
+  for (size_t i = 0; i < words.size() / 2; ++i) {
+    fresh.erase(words[i]);
+  }
+  EXPECT_EQ(copy.insert_views(views, storage, 4), fresh.size());
+  for (auto &w : words) {
+    EXPECT_EQ(copy.find(w, 0).size(), 1) << w;
+  }
+}
+
+TEST_F(BKTree_Membership_TEST, IndexFollowsCopiesOfEmptyTrees) {
+  tree_type empty;
+  empty.set_membership_index(true);
+  tree_type copy(empty);
+  EXPECT_TRUE(copy.has_membership_index());
+  EXPECT_TRUE(copy.insert("tall"));
+  EXPECT_FALSE(copy.insert("tall"));
+  EXPECT_EQ(copy.size(), 1);
+
+  tree_type assigned;
+  assigned.set_membership_index(true);
+  assigned = empty;
+  EXPECT_TRUE(assigned.has_membership_index());
+  EXPECT_TRUE(assigned.insert("tall"));
+  EXPECT_FALSE(assigned.insert("tall"));
+  EXPECT_EQ(assigned.size(), 1);
+}
+
+TEST_F(BKTree_Membership_TEST, MergeSkipsWordsAlreadyHeld) {
+  for (bool relink : {true, false}) {
+    std::pmr::monotonic_buffer_resource arena;
+    tree_type tree{"tall", "tale", "bell"};
+    tree_type other(relink ? std::pmr::get_default_resource() : &arena);
+    for (auto w : {"tall", "ball", "tale", "ball"}) {
+      other.insert(w);
+    }
+    tree.set_membership_index(true);
+    EXPECT_EQ(tree.merge(std::move(other)), 1);
+    EXPECT_EQ(tree.size(), 4);
+    EXPECT_TRUE(other.empty());
+    EXPECT_EQ(tree.find("tall", 0).size(), 1);
+    EXPECT_EQ(tree.find("ball", 0).size(), 1);
+    EXPECT_TRUE(tree.erase("tall"));
+    EXPECT_FALSE(tree.contains("tall"));
+    EXPECT_TRUE(tree.find("tall", 0).empty());
+    EXPECT_FALSE(tree.erase("tall"));
+    EXPECT_EQ(tree.size(), 3);
+  }
+
+  tree_type tree;
+  tree.set_membership_index(true);
+  for (size_t i = 0; i < words.size() / 2; ++i) {
+    tree.insert(words[i]);
+  }
+  tree_type other;
+  for (size_t i = words.size() / 4; i < words.size(); ++i) {
+    other.insert(words[i]);
+  }
+  tree.merge(std::move(other));
+  std::set<std::string> distinct(words.begin(), words.end());
+  EXPECT_EQ(tree.size(), distinct.size());
+  for (auto &w : distinct) {
+    EXPECT_EQ(tree.find(w, 0).size(), 1) << w;
+  }
+}
+
+} // namespace bk_tree_test
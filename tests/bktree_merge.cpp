@@ -0,0 +1,101 @@
+#include "gtest/gtest.h"
+
+#include "bktree.hpp"
+#include "random_words.hpp"
+#include <set>
+
+namespace bk_tree_test {
+
+class BKTree_Merge_TEST : public ::testing::Test {
+protected:
+  BKTree_Merge_TEST() {
+    words = random_words(600, 3, 2, 7, 'e');
+  }
+
+  virtual ~BKTree_Merge_TEST() {}
+
+  virtual void SetUp() {
+    // post-construction
+  }
+
+  virtual void TearDown() {
+    // pre-destruction
+  }
+
+  using tree_type = bk_tree::BKTree<bk_tree::metrics::EditDistance>;
+
+  // Checks every query against a linear scan over `expected`
+  void expect_contents(const tree_type &tree,
+                       const std::vector<std::string> &expected) {
+    EXPECT_EQ(tree.size(), expected.size());
+    bk_tree::metrics::EditDistance distance;
+    for (size_t q = 0; q < words.size(); q += 37) {
+      for (int limit = 0; limit <= 2; ++limit) {
+        std::multiset<bk_tree::ResultEntry> scan;
+        for (auto &w : expected) {
+          if (const int d = distance(words[q], w); d <= limit) {
+            scan.emplace(w, d);
+          }
+        }
+        auto found = tree.find(words[q], limit);
+        EXPECT_EQ(std::multiset<bk_tree::ResultEntry>(found.begin(), found.end()),
+                  scan);
+      }
+    }
+  }
+
+  std::vector<std::string> words;
+};
+
+TEST_F(BKTree_Merge_TEST, MergeDisjointHalves) {
+  tree_type left, right;
+  for (size_t i = 0; i < words.size(); ++i) {
+    (i < 200 ? left : right).insert(words[i]);
+  }
+  EXPECT_EQ(left.merge(std::move(right)), 400);
+  EXPECT_TRUE(right.empty());
+  EXPECT_TRUE(right.find(words[0], 3).empty());
+  expect_contents(left, words);
+}
+
+TEST_F(BKTree_Merge_TEST, MergeSharedRootGrafts) {
+  // Both trees start from the same words, so whole subtrees are grafted
+  tree_type left, right;
+  for (size_t i = 0; i < words.size(); ++i) {
+    left.insert(words[i]);
+    if (i % 3 == 0) {
+      right.insert(words[i]);
+    }
+  }
+  std::vector<std::string> expected = words;
+  for (size_t i = 0; i < words.size(); i += 3) {
+    expected.push_back(words[i]);
+  }
+  EXPECT_EQ(right.merge(std::move(left)), words.size());
+  expect_contents(right, expected);
+}
+
+TEST_F(BKTree_Merge_TEST, MergeEmpty) {
+  tree_type tree, empty;
+  EXPECT_EQ(tree.merge(std::move(empty)), 0);
+  tree.insert(words[0]);
+  EXPECT_EQ(empty.merge(std::move(tree)), 1);
+  EXPECT_EQ(empty.find(words[0], 0).size(), 1);
+  EXPECT_TRUE(tree.empty());
+  EXPECT_EQ(empty.merge(std::move(empty)), 0);
+  EXPECT_EQ(empty.size(), 1);
+}
+
+TEST_F(BKTree_Merge_TEST, MergeAcrossResources) {
+  std::pmr::monotonic_buffer_resource arena;
+  tree_type tree, other{tree_type::allocator_type(&arena)};
+  for (size_t i = 0; i < words.size(); ++i) {
+    (i % 2 == 0 ? tree : other).insert(words[i]);
+  }
+  EXPECT_EQ(tree.merge(std::move(other)), words.size() / 2);
+  EXPECT_TRUE(other.empty());
+  arena.release();
+  expect_contents(tree, words);
+}
+
+} // namespace bk_tree_test
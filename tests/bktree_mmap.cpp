@@ -0,0 +1,97 @@
+#include "gtest/gtest.h"
+
+#include "mmap.hpp"
+#include "random_words.hpp"
+#include <filesystem>
+#include <fstream>
+
+namespace bk_tree_test {
+
+class BKTree_Mmap_TEST : public ::testing::Test {
+protected:
+  BKTree_Mmap_TEST() {
+    words = random_words(2000, 5, 1, 9, 'g');
+    words[10] = words[3];
+    path = std::filesystem::temp_directory_path() /
+           ("bktree_mmap_test_" + std::to_string(::getpid()) + ".txt");
+    std::ofstream file(path, std::ios::binary);
+    for (size_t i = 0; i < words.size(); ++i) {
+      file << words[i] << (i % 7 == 0 ? "\r\n" : "\n");
+      if (i % 100 == 0) {
+        file << "\n";
+      }
+    }
+  }
+
+  virtual ~BKTree_Mmap_TEST() { std::filesystem::remove(path); }
+
+  virtual void SetUp() {
+    // post-construction
+  }
+
+  virtual void TearDown() {
+    // pre-destruction
+  }
+
+  template <typename Tree>
+  static std::vector<std::string> layout(Tree &tree) {
+    std::vector<std::string> result;
+    for (auto it = tree.begin(); it != tree.end(); ++it) {
+      result.emplace_back((*it)->word());
+    }
+    return result;
+  }
+
+  std::vector<std::string> words;
+  std::filesystem::path path;
+};
+
+TEST_F(BKTree_Mmap_TEST, LoadMatchesInsert) {
+  bk_tree::BKTree<bk_tree::metrics::EditDistance> expected;
+  for (auto &w : words) {
+    expected.insert(w);
+  }
+  for (size_t threads : {1, 4}) {
+    auto tree = bk_tree::load_dictionary<bk_tree::metrics::EditDistance>(path, threads);
+    EXPECT_EQ(tree.size(), words.size());
+    EXPECT_EQ(layout(tree), layout(expected));
+    for (int limit = 0; limit <= 2; ++limit) {
+      EXPECT_EQ(tree.find("abcd", limit), expected.find("abcd", limit));
+    }
+  }
+}
+
+TEST_F(BKTree_Mmap_TEST, LoadedTreeIsMutable) {
+  auto tree = bk_tree::load_dictionary<bk_tree::metrics::EditDistance>(path, 2);
+  const auto root = std::string((*tree.begin())->word());
+  EXPECT_TRUE(tree.erase(root));
+  EXPECT_TRUE(tree.erase(words[500]));
+  EXPECT_TRUE(tree.insert("zzzzzzzzzzzzzzzzzzzzzzzzzzzzzz"));
+  EXPECT_EQ(tree.size(), words.size() - 1);
+
+  bk_tree::BKTree<bk_tree::metrics::EditDistance> copy(tree);
+  tree = bk_tree::BKTree<bk_tree::metrics::EditDistance>();
+  EXPECT_EQ(copy.find("zzzzzzzzzzzzzzzzzzzzzzzzzzzzzz", 0).size(), 1);
+  EXPECT_EQ(copy.size(), words.size() - 1);
+}
+
+TEST_F(BKTree_Mmap_TEST, MovedTreeKeepsMapping) {
+  bk_tree::BKTree<bk_tree::metrics::HammingDistance> moved;
+  {
+    auto tree = bk_tree::load_dictionary<bk_tree::metrics::HammingDistance>(path);
+    moved = std::move(tree);
+  }
+  for (auto &p : moved.find(words[0], 1)) {
+    EXPECT_EQ(p.first.size(), words[0].size());
+  }
+  EXPECT_FALSE(moved.find(words[0], 0).empty());
+}
+
+TEST_F(BKTree_Mmap_TEST, MissingFileThrows) {
+  using metric_type = bk_tree::metrics::EditDistance;
+  EXPECT_THROW(
+      static_cast<void>(bk_tree::load_dictionary<metric_type>(path.string() + ".x")),
+      std::system_error);
+}
+
+} // namespace bk_tree_test
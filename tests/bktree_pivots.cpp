@@ -0,0 +1,133 @@
+#include "gtest/gtest.h"
+
+#include "bktree.hpp"
+#include "random_words.hpp"
+#include <set>
+
+namespace bk_tree_test {
+
+class BKTree_Pivots_TEST : public ::testing::Test {
+protected:
+  BKTree_Pivots_TEST() {
+    words = random_words(3000, 21, 3, 9, 'h');
+    queries.assign(words.begin(), words.begin() + 100);
+    for (auto &q : queries) {
+      q[q.size() / 2] = 'z';
+    }
+  }
+
+  virtual ~BKTree_Pivots_TEST() {}
+
+  virtual void SetUp() {
+    // post-construction
+  }
+
+  virtual void TearDown() {
+    // pre-destruction
+  }
+
+  using tree_type = bk_tree::BKTree<bk_tree::metrics::EditDistance>;
+
+  static std::multiset<bk_tree::ResultEntry> found(const bk_tree::ResultList &results) {
+    return {results.begin(), results.end()};
+  }
+
+  std::vector<std::string> words, queries;
+};
+
+TEST_F(BKTree_Pivots_TEST, SameResultsWithFewerEvaluations) {
+  tree_type plain, pivoted;
+  for (auto &w : words) {
+    plain.insert(w);
+    pivoted.insert(w);
+  }
+  pivoted.select_pivots(8);
+  EXPECT_EQ(pivoted.pivot_count(), 8);
+  for (int limit = 0; limit <= 3; ++limit) {
+    for (auto &q : queries) {
+      EXPECT_EQ(found(pivoted.find(q, limit)), found(plain.find(q, limit))) << q;
+    }
+  }
+  EXPECT_GT(pivoted.pivot_skips(), 0);
+  EXPECT_EQ(plain.pivot_skips(), 0);
+
+  size_t skips = pivoted.pivot_skips();
+  auto batch = pivoted.find_batch(queries, 2);
+  EXPECT_GT(pivoted.pivot_skips(), skips);
+  for (size_t i = 0; i < queries.size(); ++i) {
+    EXPECT_EQ(found(batch[i]), found(plain.find(queries[i], 2)));
+    bk_tree::ResultList lazy;
+    for (auto &entry : pivoted.find_lazy(queries[i], 2)) {
+      lazy.push_back(entry);
+    }
+    EXPECT_EQ(found(lazy), found(plain.find(queries[i], 2)));
+  }
+  skips = pivoted.pivot_skips();
+  for (auto &q : queries) {
+    auto bounded = pivoted.find_bounded(q, 2, {});
+    EXPECT_TRUE(bounded.complete);
+    EXPECT_EQ(found(bounded.results), found(plain.find(q, 2)));
+  }
+  EXPECT_GT(pivoted.pivot_skips(), skips);
+  EXPECT_EQ(plain.pivot_skips(), 0);
+}
+
+TEST_F(BKTree_Pivots_TEST, UpdatesKeepPivotDistances) {
+  tree_type plain, pivoted;
+  pivoted.set_pivots({"abc", "hhhhhhh", "dead"});
+  for (size_t i = 0; i < words.size(); ++i) {
+    plain.insert(words[i]);
+    pivoted.insert(words[i]);
+    if (i % 3 == 0) {
+      plain.erase(words[i / 2]);
+      pivoted.erase(words[i / 2]);
+    }
+  }
+  tree_type other;
+  other.select_pivots(4);
+  for (auto &q : queries) {
+    other.insert(q);
+    plain.insert(q);
+  }
+  pivoted.merge(std::move(other));
+  tree_type copy(pivoted), rebuilt = pivoted.rebuilt();
+  EXPECT_EQ(copy.pivots(), pivoted.pivots());
+  EXPECT_EQ(rebuilt.pivots(), pivoted.pivots());
+  for (auto &q : queries) {
+    const auto expected = found(plain.find(q, 2));
+    EXPECT_EQ(found(pivoted.find(q, 2)), expected) << q;
+    EXPECT_EQ(found(copy.find(q, 2)), expected) << q;
+    EXPECT_EQ(found(rebuilt.find(q, 2)), expected) << q;
+  }
+
+  pivoted.set_pivots({});
+  EXPECT_EQ(pivoted.pivot_count(), 0);
+  EXPECT_EQ(found(pivoted.find(queries.front(), 2)),
+            found(plain.find(queries.front(), 2)));
+}
+
+TEST_F(BKTree_Pivots_TEST, RejectedPivotDistancesAreIgnored) {
+  bk_tree::BKTree<bk_tree::metrics::HammingDistance> tree;
+  for (auto &w : words) {
+    if (w.size() == 5) {
+      tree.insert(w);
+    }
+  }
+  // The first pivot has another length, so every distance to it is rejected
+  tree.set_pivots({"abcdefgh", "abcde"});
+  for (auto &q : queries) {
+    if (q.size() == 5) {
+      auto results = tree.find(q, 1);
+      std::multiset<bk_tree::ResultEntry> expected;
+      for (auto &w : words) {
+        const int distance = bk_tree::metrics::HammingDistance()(q, w);
+        if (w.size() == 5 && distance <= 1) {
+          expected.emplace(w, distance);
+        }
+      }
+      EXPECT_EQ(found(results), expected) << q;
+    }
+  }
+}
+
+} // namespace bk_tree_test
@@ -0,0 +1,127 @@
+#include "gtest/gtest.h"
+
+#include "bktree.hpp"
+#include <memory_resource>
+#include <set>
+
+namespace bk_tree_test {
+
+class CountingResource : public std::pmr::memory_resource {
+public:
+  size_t allocated = 0, deallocated = 0;
+
+private:
+  void *do_allocate(size_t bytes, size_t alignment) override {
+    allocated += bytes;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+  void do_deallocate(void *p, size_t bytes, size_t alignment) override {
+    deallocated += bytes;
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+  bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+    return this == &other;
+  }
+};
+
+class BKTree_PMR_TEST : public ::testing::Test {
+protected:
+  BKTree_PMR_TEST() {}
+
+  virtual ~BKTree_PMR_TEST() {}
+
+  virtual void SetUp() {
+    // post-construction
+  }
+
+  virtual void TearDown() {
+    // pre-destruction
+  }
+
+  static std::set<bk_tree::ResultEntry> as_set(const bk_tree::ResultList &results) {
+    return {results.begin(), results.end()};
+  }
+
+  std::vector<std::string> input{"tall",  "tell",  "teel",  "feel", "tally",
+                                 "tuck",  "belly", "kelly", "kill",
+                                 "a considerably longer word than fits in SSO"};
+};
+
+TEST_F(BKTree_PMR_TEST, NodesComeFromResource) {
+  CountingResource resource;
+  {
+    bk_tree::BKTree<bk_tree::metrics::EditDistance> tree(&resource);
+    EXPECT_EQ(tree.get_allocator().resource(), &resource);
+    for (auto &s : input) {
+      tree.insert(s);
+    }
+    EXPECT_GT(resource.allocated, 0);
+    EXPECT_TRUE(tree.erase("kill"));
+    EXPECT_EQ(tree.size(), input.size() - 1);
+  }
+  EXPECT_EQ(resource.allocated, resource.deallocated);
+}
+
+TEST_F(BKTree_PMR_TEST, FindMatchesDefaultResource) {
+  std::pmr::monotonic_buffer_resource buffer;
+  bk_tree::BKTree<bk_tree::metrics::EditDistance> arena_tree(&buffer), tree;
+  for (auto &s : input) {
+    arena_tree.insert(s);
+    tree.insert(s);
+  }
+  for (int limit = 0; limit <= 3; limit++) {
+    EXPECT_EQ(as_set(arena_tree.find("tale", limit)), as_set(tree.find("tale", limit)));
+  }
+}
+
+TEST_F(BKTree_PMR_TEST, PmrResultList) {
+  CountingResource resource;
+  bk_tree::BKTree<bk_tree::metrics::EditDistance> tree;
+  for (auto &s : input) {
+    tree.insert(s);
+  }
+  {
+    bk_tree::pmr::ResultList results(&resource);
+    tree.find("a considerably longer word than fits in SS0", 2, results);
+    ASSERT_EQ(results.size(), 1);
+    EXPECT_EQ(std::string_view(results[0].first), input.back());
+    EXPECT_EQ(results[0].first.get_allocator().resource(), &resource);
+    tree.find("tale", 1, results);
+    EXPECT_EQ(results.size(), 1 + tree.find("tale", 1).size());
+  }
+  EXPECT_GT(resource.allocated, 0);
+  EXPECT_EQ(resource.allocated, resource.deallocated);
+}
+
+TEST_F(BKTree_PMR_TEST, CopyAndMove) {
+  CountingResource resource;
+  bk_tree::BKTree<bk_tree::metrics::EditDistance> tree(&resource);
+  for (auto &s : input) {
+    tree.insert(s);
+  }
+  bk_tree::BKTree<bk_tree::metrics::EditDistance> copy(tree);
+  EXPECT_EQ(copy.get_allocator().resource(), std::pmr::get_default_resource());
+  EXPECT_EQ(copy.size(), tree.size());
+
+  const size_t allocated = resource.allocated;
+  bk_tree::BKTree<bk_tree::metrics::EditDistance> moved(std::move(tree));
+  EXPECT_EQ(moved.get_allocator().resource(), &resource);
+  EXPECT_EQ(resource.allocated, allocated);
+  EXPECT_EQ(as_set(moved.find("tale", 2)), as_set(copy.find("tale", 2)));
+}
+
+TEST_F(BKTree_PMR_TEST, AbandonMonotonic) {
+  std::pmr::monotonic_buffer_resource buffer;
+  bk_tree::BKTree<bk_tree::metrics::EditDistance> tree(&buffer);
+  for (auto &s : input) {
+    tree.insert(s);
+  }
+  tree.abandon();
+  EXPECT_TRUE(tree.empty());
+  EXPECT_TRUE(tree.find("tall", 1).empty());
+  buffer.release();
+  tree.insert("tall");
+  EXPECT_EQ(tree.find("tall", 0).size(), 1);
+}
+
+} // namespace bk_tree_test
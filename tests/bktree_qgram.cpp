@@ -0,0 +1,84 @@
+#include "gtest/gtest.h"
+
+#include "qgram.hpp"
+#include "random_words.hpp"
+#include <set>
+
+namespace bk_tree_test {
+
+class BKTree_QGram_TEST : public ::testing::Test {
+protected:
+  BKTree_QGram_TEST() {
+    words = random_words(1500, 23, 0, 9, 'e');
+    words.push_back(words[5]);
+    words.push_back(std::string(1, '\0') + "ab\x01");
+  }
+
+  virtual ~BKTree_QGram_TEST() {}
+
+  virtual void SetUp() {
+    // post-construction
+  }
+
+  virtual void TearDown() {
+    // pre-destruction
+  }
+
+  // Compares every query against a linear scan; a BKTree is not exact for
+  // DamerauLevenshteinDistance, which breaks the triangle inequality
+  template <typename Metric, size_t Q>
+  void expect_same_as_scan() {
+    bk_tree::QGramIndex<Metric, Q> index;
+    for (auto &w : words) {
+      EXPECT_TRUE(index.insert(w));
+    }
+    EXPECT_EQ(index.size(), words.size());
+    std::vector<std::string> queries{"", "a", "abcde", "eeeeeeeeeeee", words.back()};
+    for (size_t i = 0; i < words.size(); i += 101) {
+      queries.push_back(words[i]);
+    }
+    Metric metric;
+    for (auto &query : queries) {
+      for (int limit = 0; limit <= 5; ++limit) {
+        std::multiset<bk_tree::ResultEntry> expected;
+        for (auto &w : words) {
+          const int d = metric(query, w);
+          if (d >= 0 && d <= limit) {
+            expected.emplace(w, d);
+          }
+        }
+        auto actual = index.find(query, limit);
+        EXPECT_EQ(std::multiset<bk_tree::ResultEntry>(actual.begin(), actual.end()),
+                  expected)
+            << query << " within " << limit;
+      }
+    }
+  }
+
+  std::vector<std::string> words;
+};
+
+TEST_F(BKTree_QGram_TEST, EditMatchesScan) {
+  expect_same_as_scan<bk_tree::metrics::EditDistance, 2>();
+  expect_same_as_scan<bk_tree::metrics::EditDistance, 3>();
+}
+
+TEST_F(BKTree_QGram_TEST, DamerauMatchesScan) {
+  expect_same_as_scan<bk_tree::metrics::DamerauLevenshteinDistance, 2>();
+}
+
+TEST_F(BKTree_QGram_TEST, HammingMatchesScan) {
+  expect_same_as_scan<bk_tree::metrics::HammingDistance, 1>();
+  expect_same_as_scan<bk_tree::metrics::HammingDistance, 4>();
+}
+
+TEST_F(BKTree_QGram_TEST, EmptyIndex) {
+  bk_tree::QGramIndex<bk_tree::metrics::EditDistance> index;
+  EXPECT_TRUE(index.empty());
+  EXPECT_TRUE(index.find("abc", 3).empty());
+  bk_tree::QGramIndex<bk_tree::metrics::EditDistance> list{"ab", "ba", "abc"};
+  EXPECT_EQ(list.find("ab", -1).size(), 0);
+  EXPECT_EQ(list.find("ab", 1).size(), 2);
+}
+
+} // namespace bk_tree_test
@@ -0,0 +1,85 @@
+#include "gtest/gtest.h"
+
+#include "bktree.hpp"
+#include "random_words.hpp"
+#include <future>
+#include <set>
+
+namespace bk_tree_test {
+
+class BKTree_Rebuild_TEST : public ::testing::Test {
+protected:
+  BKTree_Rebuild_TEST() {
+    words = random_words(2000, 9, 3, 8, 'f');
+  }
+
+  virtual ~BKTree_Rebuild_TEST() {}
+
+  virtual void SetUp() {
+    // post-construction
+  }
+
+  virtual void TearDown() {
+    // pre-destruction
+  }
+
+  using tree_type = bk_tree::BKTree<bk_tree::metrics::EditDistance>;
+
+  static std::multiset<bk_tree::ResultEntry> found(const tree_type &tree,
+                                                   std::string_view query) {
+    auto results = tree.find(query, 2);
+    return {results.begin(), results.end()};
+  }
+
+  std::vector<std::string> words;
+};
+
+TEST_F(BKTree_Rebuild_TEST, EraseDegradesAndRebuildRestores) {
+  tree_type tree;
+  tree.set_rebuild_policy({0, 0});
+  for (auto &w : words) {
+    tree.insert(w);
+  }
+  EXPECT_EQ(tree.degradation(), 0.0);
+  for (size_t i = 0; i < 100; ++i) {
+    EXPECT_TRUE(tree.erase(words[i]));
+  }
+  EXPECT_GT(tree.degradation(), 0.0);
+
+  tree_type copy(tree);
+  EXPECT_EQ(copy.degradation(), tree.degradation());
+  tree.rebuild();
+  EXPECT_EQ(tree.degradation(), 0.0);
+  EXPECT_EQ(tree.size(), copy.size());
+  for (size_t i = 0; i < words.size(); i += 41) {
+    EXPECT_EQ(found(tree, words[i]), found(copy, words[i]));
+  }
+}
+
+TEST_F(BKTree_Rebuild_TEST, PolicyTriggersRebuild) {
+  tree_type tree;
+  tree.set_rebuild_policy({0.2, 100});
+  EXPECT_EQ(tree.rebuild_policy().min_size, 100);
+  for (auto &w : words) {
+    tree.insert(w);
+  }
+  for (size_t i = 0; i < 1000; ++i) {
+    tree.erase(words[i]);
+    EXPECT_LT(tree.degradation(), 0.2);
+  }
+  EXPECT_EQ(tree.size(), words.size() - 1000);
+}
+
+TEST_F(BKTree_Rebuild_TEST, RebuiltOnAnotherThread) {
+  tree_type tree;
+  for (auto &w : words) {
+    tree.insert(w);
+  }
+  auto pending = std::async(std::launch::async, [&tree] { return tree.rebuilt(); });
+  const auto before = found(tree, words[7]);
+  tree = pending.get();
+  EXPECT_EQ(found(tree, words[7]), before);
+  EXPECT_EQ(tree.size(), words.size());
+}
+
+} // namespace bk_tree_test
@@ -0,0 +1,118 @@
+#include "gtest/gtest.h"
+
+#include "bktree.hpp"
+#include "random_words.hpp"
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+
+namespace bk_tree_test {
+
+class BKTree_Traversal_TEST : public ::testing::Test {
+protected:
+  BKTree_Traversal_TEST() {
+    words = random_words(2000, 5, 2, 8, 'f');
+    for (auto &w : words) {
+      tree.insert(w);
+    }
+  }
+
+  virtual ~BKTree_Traversal_TEST() {}
+
+  virtual void SetUp() {
+    // post-construction
+  }
+
+  virtual void TearDown() {
+    // pre-destruction
+  }
+
+  using tree_type = bk_tree::BKTree<bk_tree::metrics::EditDistance>;
+
+  template <typename Range>
+  static std::multiset<std::string> collect(Range &&range) {
+    std::multiset<std::string> found;
+    for (auto word : range) {
+      found.emplace(word);
+    }
+    return found;
+  }
+
+  std::vector<std::string> words;
+  tree_type tree;
+};
+
+TEST_F(BKTree_Traversal_TEST, WordsVisitEveryNode) {
+  const tree_type &view = tree;
+  const std::multiset<std::string> expected(words.begin(), words.end());
+  EXPECT_EQ(collect(view.words()), expected);
+  EXPECT_EQ(collect(view.words<bk_tree::Traversal::breadth_first>()), expected);
+  EXPECT_EQ(*view.words().begin(), words.front());
+
+  // Breadth-first matches the node iterator
+  std::vector<std::string_view> nodes, breadth;
+  for (auto it = tree.begin(); it != tree.end(); ++it) {
+    nodes.push_back((*it)->word());
+  }
+  std::ranges::copy(view.words<bk_tree::Traversal::breadth_first>(),
+                    std::back_inserter(breadth));
+  EXPECT_EQ(breadth, nodes);
+
+  EXPECT_TRUE(tree_type().words().empty());
+  EXPECT_TRUE(collect(tree_type().words<bk_tree::Traversal::breadth_first>()).empty());
+}
+
+TEST_F(BKTree_Traversal_TEST, WordsComposeWithRanges) {
+  using view_type = decltype(tree.words());
+  static_assert(std::ranges::forward_range<view_type>);
+  static_assert(std::ranges::view<view_type>);
+  static_assert(std::same_as<std::ranges::range_value_t<view_type>, std::string_view>);
+
+  auto is_short = [](std::string_view w) { return w.size() < 4; };
+  auto short_words = tree.words() | std::views::filter(is_short);
+  const auto expected = std::ranges::count_if(words, is_short);
+  EXPECT_EQ(std::ranges::distance(short_words), expected);
+
+  auto it = tree.words().begin();
+  auto copy = it++;
+  EXPECT_EQ(*copy, words.front());
+  EXPECT_NE(copy, it);
+  EXPECT_EQ(++copy, it);
+}
+
+TEST_F(BKTree_Traversal_TEST, ParallelForEachVisitsEveryWordOnce) {
+  const std::multiset<std::string> expected(words.begin(), words.end());
+  for (size_t threads : {1, 3, 8, 64}) {
+    std::mutex mutex;
+    std::multiset<std::string> found;
+    tree.parallel_for_each(
+        [&](std::string_view w) {
+          std::lock_guard lock(mutex);
+          found.emplace(w);
+        },
+        threads);
+    EXPECT_EQ(found, expected) << threads;
+  }
+
+  tree_type small{"one", "two"};
+  std::atomic<size_t> count = 0;
+  small.parallel_for_each([&](std::string_view) { ++count; }, 8);
+  EXPECT_EQ(count.load(), 2);
+  tree_type().parallel_for_each([&](std::string_view) { ++count; }, 8);
+  EXPECT_EQ(count.load(), 2);
+}
+
+TEST_F(BKTree_Traversal_TEST, ParallelForEachRethrows) {
+  std::atomic<size_t> count = 0;
+  auto fail = [&](std::string_view w) {
+    ++count;
+    if (w == words[words.size() / 2]) {
+      throw std::runtime_error("stop");
+    }
+  };
+  EXPECT_THROW(tree.parallel_for_each(fail, 4), std::runtime_error);
+  EXPECT_LE(count.load(), words.size());
+}
+
+} // namespace bk_tree_test
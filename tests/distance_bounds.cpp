@@ -0,0 +1,86 @@
+#include "gtest/gtest.h"
+
+#include "bktree.hpp"
+#include "random_words.hpp"
+#include <set>
+
+namespace bk_tree_test {
+
+class Distance_Bounds_TEST : public ::testing::Test {
+protected:
+  Distance_Bounds_TEST() {
+    words = random_words(300, 7, 0, 10, 'h');
+  }
+
+  virtual ~Distance_Bounds_TEST() {}
+
+  virtual void SetUp() {
+    // post-construction
+  }
+
+  virtual void TearDown() {
+    // pre-destruction
+  }
+
+  template <typename Metric>
+  void expect_bounds_hold(const Metric &metric) {
+    for (size_t i = 0; i < words.size(); i += 3) {
+      for (size_t j = 0; j < words.size(); j += 5) {
+        const bk_tree::metrics::WordSketch s(words[i]), t(words[j]);
+        const auto distance = metric(words[i], words[j]);
+        EXPECT_LE(metric.lower_bound(s, t), distance) << words[i] << " " << words[j];
+        EXPECT_GE(metric.upper_bound(s, t), distance) << words[i] << " " << words[j];
+      }
+    }
+  }
+
+  template <typename Metric>
+  void expect_find_matches_scan(const Metric &metric) {
+    bk_tree::BKTree<Metric> tree;
+    for (auto &w : words) {
+      tree.insert(w);
+    }
+    for (int limit = 0; limit <= 3; ++limit) {
+      for (size_t i = 0; i < words.size(); i += 17) {
+        std::multiset<bk_tree::ResultEntry> expected, actual;
+        for (auto &w : words) {
+          const int distance = metric(words[i], w);
+          if (distance <= limit) {
+            expected.insert({w, distance});
+          }
+        }
+        for (auto &p : tree.find(words[i], limit)) {
+          actual.insert(p);
+        }
+        EXPECT_EQ(actual, expected);
+      }
+    }
+  }
+
+  std::vector<std::string> words;
+};
+
+TEST_F(Distance_Bounds_TEST, SketchSignature) {
+  bk_tree::metrics::WordSketch s("abc"), t("ABC"), u("cab");
+  EXPECT_EQ(s.length, 3);
+  EXPECT_EQ(s.signature, u.signature);
+  EXPECT_NE(s.signature, t.signature);
+  EXPECT_EQ(missing_classes(s, t), 3);
+  EXPECT_EQ(missing_classes(s, u), 0);
+}
+
+TEST_F(Distance_Bounds_TEST, EditBounds) {
+  expect_bounds_hold(bk_tree::metrics::EditDistance());
+  expect_find_matches_scan(bk_tree::metrics::EditDistance());
+}
+
+TEST_F(Distance_Bounds_TEST, DamerauLevenshteinBounds) {
+  expect_bounds_hold(bk_tree::metrics::DamerauLevenshteinDistance());
+  expect_find_matches_scan(bk_tree::metrics::DamerauLevenshteinDistance());
+}
+
+TEST_F(Distance_Bounds_TEST, LCSubseqBounds) {
+  expect_bounds_hold(bk_tree::metrics::LCSubseqDistance());
+}
+
+} // namespace bk_tree_test
@@ -35,4 +35,20 @@ TEST_F(Distance_DamerauLevenshtein_TEST, DamerauLevenshteinDistances) {
   EXPECT_TRUE(dist("abcd", "abdc") == 1);
 }
 
+TEST_F(Distance_DamerauLevenshtein_TEST, LongDamerauLevenshteinDistances) {
+  for (size_t repeat : {2, 26, 30}) {
+    std::string s;
+    for (size_t i = 0; i < repeat; ++i) {
+      s += "abcdefghij";
+    }
+    std::string t = s;
+    std::swap(t[0], t[1]);
+    std::swap(t[s.size() / 2], t[s.size() / 2 + 1]);
+    std::swap(t[s.size() - 2], t[s.size() - 1]);
+    EXPECT_EQ(dist(s, t), 3);
+    EXPECT_EQ(dist(s, t + "x"), 4);
+    EXPECT_EQ(dist(s, std::string(s.size(), 'z')), s.size());
+  }
+}
+
 } // namespace bk_tree_test
@@ -1,6 +1,7 @@
 #include "gtest/gtest.h"
 
 #include "bktree.hpp"
+#include <random>
 
 namespace bk_tree_test {
 
@@ -33,4 +34,46 @@ TEST_F(Distance_Edit_TEST, EditDistances) {
   EXPECT_TRUE(dist("", "") == 0);
 }
 
+TEST_F(Distance_Edit_TEST, LongEditDistances) {
+  // Lengths cross the anti-diagonal kernel and the 8-bit cell thresholds
+  for (size_t length : {20, 254, 255, 300}) {
+    std::string s(length, 'a'), t = s;
+    t[3] = t[length / 2] = t[length - 1] = 'b';
+    EXPECT_EQ(dist(s, t), 3);
+    EXPECT_EQ(dist(s, t + "cd"), 5);
+    EXPECT_EQ(dist(s, std::string(length, 'b')), length);
+    EXPECT_EQ(dist(s, t.substr(7)), 9);
+  }
+}
+
+TEST_F(Distance_Edit_TEST, PreparedQueries) {
+  // Queries on both sides of the 64-character bit-parallel limit
+  std::mt19937 rng(3);
+  auto random_word = [&rng](size_t max_length) {
+    std::string w(rng() % (max_length + 1), ' ');
+    for (auto &c : w) {
+      c = static_cast<char>('a' + rng() % 3);
+    }
+    return w;
+  };
+  for (int round = 0; round < 300; ++round) {
+    const std::string query = random_word(round % 2 == 0 ? 70 : 12);
+    const auto prepared = dist.prepare(query);
+    EXPECT_EQ(prepared.query(), query);
+    std::vector<std::string> words;
+    for (int i = 0; i < 9; ++i) {
+      words.push_back(random_word(query.size() + 4));
+    }
+    std::vector<std::string_view> views(words.begin(), words.end());
+    std::vector<bk_tree::integer_type> batch(views.size());
+    prepared.batch(views, batch);
+    for (size_t i = 0; i < words.size(); ++i) {
+      EXPECT_EQ(prepared(words[i]), dist(query, words[i])) << query << " " << words[i];
+      EXPECT_EQ(batch[i], dist(query, words[i])) << query << " " << words[i];
+    }
+  }
+  EXPECT_EQ(dist.prepare("")("peter"), 5);
+  EXPECT_EQ(dist.prepare("kitten")(""), 6);
+}
+
 } // namespace bk_tree_test
@@ -37,4 +37,17 @@ TEST_F(Distance_LCSubseq_TEST, LCSubseqDistances) {
   EXPECT_TRUE(5 + 5 - 2 * dist("abcde", "abcde") == edit_dist("abcde", "abcde"));
 }
 
+TEST_F(Distance_LCSubseq_TEST, LongLCSubseqDistances) {
+  for (size_t repeat : {5, 85, 100}) {
+    std::string s;
+    for (size_t i = 0; i < repeat; ++i) {
+      s += "abc";
+    }
+    EXPECT_EQ(dist(s, s), s.size());
+    EXPECT_EQ(dist(s, s.substr(5)), s.size() - 5);
+    EXPECT_EQ(dist(s, std::string(s.size(), 'x')), 0);
+    EXPECT_EQ(dist(s, "x" + s + "y"), s.size());
+  }
+}
+
 } // namespace bk_tree_test
@@ -0,0 +1,72 @@
+#include "gtest/gtest.h"
+
+#include "bktree.hpp"
+#include <random>
+
+namespace bk_tree_test {
+
+class Distance_Weighted_TEST : public ::testing::Test {
+protected:
+  Distance_Weighted_TEST() {}
+
+  virtual ~Distance_Weighted_TEST() {}
+
+  virtual void SetUp() {
+    // post-construction
+  }
+
+  virtual void TearDown() {
+    // pre-destruction
+  }
+
+  bk_tree::metrics::WeightedEditDistance<bk_tree::metrics::UnitCost> unit;
+  bk_tree::metrics::WeightedEditDistance<bk_tree::metrics::QwertyCost> qwerty;
+};
+
+TEST_F(Distance_Weighted_TEST, UnitCostDistances) {
+  bk_tree::metrics::EditDistance edit;
+  std::mt19937 rng(11);
+  std::uniform_int_distribution<int> length(0, 9), letter('a', 'f');
+  for (int n = 0; n < 500; ++n) {
+    std::string s(length(rng), ' '), t(length(rng), ' ');
+    for (auto &c : s) {
+      c = static_cast<char>(letter(rng));
+    }
+    for (auto &c : t) {
+      c = static_cast<char>(letter(rng));
+    }
+    EXPECT_EQ(unit(s, t), edit(s, t)) << s << " " << t;
+  }
+  EXPECT_TRUE(unit("kitten", "sitting") == 3);
+  EXPECT_TRUE(unit("", "") == 0);
+}
+
+TEST_F(Distance_Weighted_TEST, QwertyCostDistances) {
+  EXPECT_TRUE(qwerty("cat", "cat") == 0);
+  EXPECT_TRUE(qwerty("cat", "vat") == 1);
+  EXPECT_TRUE(qwerty("cat", "xat") == 1);
+  EXPECT_TRUE(qwerty("cat", "Cat") == 1);
+  EXPECT_TRUE(qwerty("cat", "bat") == 2);
+  EXPECT_TRUE(qwerty("cat", "cats") == 2);
+  EXPECT_TRUE(qwerty("cat", "") == 6);
+  EXPECT_TRUE(qwerty("", "cat") == 6);
+  EXPECT_TRUE(qwerty("sword", "swprd") == 1);
+  EXPECT_TRUE(qwerty("sword", "swprd") == qwerty("swprd", "sword"));
+}
+
+TEST_F(Distance_Weighted_TEST, QwertyTreeFind) {
+  bk_tree::BKTree<bk_tree::metrics::WeightedEditDistance<bk_tree::metrics::QwertyCost>>
+      tree{"sword", "swore", "sworn", "words", "swords", "award"};
+  auto results = tree.find("swprd", 1);
+  ASSERT_EQ(results.size(), 1);
+  EXPECT_EQ(results[0].first, "sword");
+  EXPECT_EQ(results[0].second, 1);
+  results = tree.find("swprd", 3);
+  for (auto &p : results) {
+    EXPECT_EQ(qwerty("swprd", p.first), p.second);
+    EXPECT_LE(p.second, 3);
+  }
+  EXPECT_EQ(results.size(), 5);
+}
+
+} // namespace bk_tree_test
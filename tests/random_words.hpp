@@ -0,0 +1,29 @@
+#pragma once
+
+#include <random>
+#include <string>
+#include <vector>
+
+namespace bk_tree_test {
+
+/**
+ * @brief `count` words of `min_length` to `max_length` letters from 'a' to
+ * `last_letter`, the same for the same `seed`
+ */
+inline std::vector<std::string> random_words(size_t count, unsigned seed,
+                                             int min_length, int max_length,
+                                             char last_letter) {
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<int> length(min_length, max_length),
+      letter('a', last_letter);
+  std::vector<std::string> words(count);
+  for (auto &w : words) {
+    w.resize(length(rng));
+    for (auto &c : w) {
+      c = static_cast<char>(letter(rng));
+    }
+  }
+  return words;
+}
+
+} // namespace bk_tree_test